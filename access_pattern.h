@@ -0,0 +1,212 @@
+#ifndef ACCESS_PATTERN_H
+#define ACCESS_PATTERN_H
+
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <cstdint> // for uint64_t
+#include <algorithm> // for std::upper_bound
+#include <memory>
+#include <vector>
+
+#include "rng.h"
+
+// a compile time constant so the walks can shift instead of multiply. the
+// topology reports the real line size and the driver warns on a mismatch.
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+// knobs for do_mem_access and the patterns. the defaults are the original
+// hardcoded walk: 2^20 windows of 512 lines (32KB), 16 passes each, every
+// 8th line a store.
+struct access_params {
+    bool precompute;        // generate every window start before the timed walk
+    long iterations;        // windows visited
+    int window_lines;       // cache lines per working-set window
+    int locality;           // passes over each window
+    double write_fraction;  // fraction of line touches that are stores
+    int line_stride;        // lines between touches inside a window
+    long stride_lines;      // strided: distance between window starts
+    double zipf_theta;      // zipfian: skew, 0 = uniform, ~1 = very hot head
+    double hot_center;      // gaussian: hot spot center, fraction of the region
+    double hot_width;       // gaussian: standard deviation, fraction of the region
+    long phase_iterations;  // mixed: windows per phase
+};
+
+static const access_params DEFAULT_ACCESS_PARAMS = {
+    true, 1 << 20, 512, 16, 0.125, 1, 4096, 0.99, 0.5, 0.02, 1 << 16
+};
+
+// an access pattern hands out the first line of each window, in
+// [0, max_base]. one pattern object per walking thread; patterns draw from
+// thread_rng() so threads never share generator state.
+class AccessPattern {
+public:
+    explicit AccessPattern(long max_base) : max_base_(max_base) {}
+    virtual ~AccessPattern() {}
+    virtual long next_base() = 0;
+
+    // the next n window starts in one go, for precomputed streams.
+    virtual void fill(long* out, long n) {
+        for (long i = 0; i < n; i++) {
+            out[i] = next_base();
+        }
+    }
+protected:
+    long max_base_;
+};
+
+// back to back windows, wrapping at the end of the region.
+class SequentialPattern : public AccessPattern {
+public:
+    SequentialPattern(long max_base, long step) : AccessPattern(max_base), base_(-step), step_(step) {}
+    long next_base() override {
+        base_ += step_;
+        if (base_ >= max_base_) {
+            base_ = 0;
+        }
+        return base_;
+    }
+private:
+    long base_;
+    long step_;
+};
+
+// windows start anywhere, uniformly. bulk fills come from the 4-lane
+// generator, seeded from the thread's own stream.
+class UniformPattern : public AccessPattern {
+public:
+    explicit UniformPattern(long max_base) : AccessPattern(max_base), batch_(thread_rng().next()) {}
+    long next_base() override { return (long) thread_rng().below(max_base_ + 1); }
+    void fill(long* out, long n) override {
+        uint64_t buf[256];
+        for (long i = 0; i < n; i += 256) {
+            long chunk = n - i < 256 ? n - i : 256;
+            batch_.fill(buf, 256);
+            for (long k = 0; k < chunk; k++) {
+                out[i + k] = (long) fast_range(buf[k], max_base_ + 1);
+            }
+        }
+    }
+private:
+    Xoshiro256ssx4 batch_;
+};
+
+// the region is cut into window-sized keys and key popularity follows a
+// zipf distribution. hot keys are scattered over the region by a fixed
+// shuffle so rank 0 is not always the first window.
+class ZipfianPattern : public AccessPattern {
+public:
+    ZipfianPattern(long max_base, long window, double theta) : AccessPattern(max_base), window_(window) {
+        long keys = max_base / window + 1;
+        cdf_.resize(keys);
+        key_of_rank_.resize(keys);
+        double sum = 0;
+        for (long k = 0; k < keys; k++) {
+            sum += 1.0 / pow((double) (k + 1), theta);
+            cdf_[k] = sum;
+            key_of_rank_[k] = k;
+        }
+        for (long k = 0; k < keys; k++) {
+            cdf_[k] /= sum;
+        }
+        for (long k = keys - 1; k > 0; k--) {
+            std::swap(key_of_rank_[k], key_of_rank_[thread_rng().below(k + 1)]);
+        }
+    }
+    long next_base() override {
+        double u = thread_rng().unit();
+        size_t rank = std::upper_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin();
+        if (rank >= cdf_.size()) {
+            rank = cdf_.size() - 1;
+        }
+        return key_of_rank_[rank] * window_;
+    }
+private:
+    long window_;
+    std::vector<double> cdf_;
+    std::vector<long> key_of_rank_;
+};
+
+// windows cluster around one hot spot with a normal spread.
+class GaussianPattern : public AccessPattern {
+public:
+    GaussianPattern(long max_base, double center, double width)
+        : AccessPattern(max_base), center_(center * max_base), sigma_(width * max_base) {}
+    long next_base() override {
+        // box-muller.
+        double u1 = thread_rng().unit() + 1e-12;
+        double u2 = thread_rng().unit();
+        double n = sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+        long base = (long) (center_ + n * sigma_);
+        if (base < 0) {
+            base = 0;
+        } else if (base > max_base_) {
+            base = max_base_;
+        }
+        return base;
+    }
+private:
+    double center_;
+    double sigma_;
+};
+
+// cycles through other patterns, phase_iterations windows each.
+class MixedPattern : public AccessPattern {
+public:
+    MixedPattern(long max_base, long phase_iterations)
+        : AccessPattern(max_base), phase_iterations_(phase_iterations), count_(0), phase_(0) {}
+    void add_phase(std::unique_ptr<AccessPattern> pattern) { phases_.push_back(std::move(pattern)); }
+    long next_base() override {
+        if (count_++ == phase_iterations_) {
+            count_ = 1;
+            phase_ = (phase_ + 1) % phases_.size();
+        }
+        return phases_[phase_]->next_base();
+    }
+private:
+    long phase_iterations_;
+    long count_;
+    size_t phase_;
+    std::vector<std::unique_ptr<AccessPattern>> phases_;
+};
+
+static const char* const ACCESS_PATTERN_NAMES[] = {
+    "sequential", "random", "strided", "zipfian", "gaussian", "mixed"
+};
+
+static const size_t NUM_ACCESS_PATTERNS = sizeof(ACCESS_PATTERN_NAMES) / sizeof(ACCESS_PATTERN_NAMES[0]);
+
+// build a pattern by name for a region of size bytes. returns nullptr for an
+// unknown name or a region smaller than one window.
+static inline std::unique_ptr<AccessPattern> make_access_pattern(const char* name, long size,
+                                                                 const access_params& params) {
+    long max_base = size / CACHE_LINE_SIZE - (long) params.window_lines * params.line_stride;
+    if (max_base < 0) {
+        printf("Region too small for a %d line window.\n", params.window_lines);
+        return nullptr;
+    }
+    if (strcmp(name, "sequential") == 0) {
+        return std::unique_ptr<AccessPattern>(new SequentialPattern(max_base, params.window_lines));
+    } else if (strcmp(name, "random") == 0) {
+        return std::unique_ptr<AccessPattern>(new UniformPattern(max_base));
+    } else if (strcmp(name, "strided") == 0) {
+        return std::unique_ptr<AccessPattern>(new SequentialPattern(max_base, params.stride_lines));
+    } else if (strcmp(name, "zipfian") == 0) {
+        return std::unique_ptr<AccessPattern>(new ZipfianPattern(max_base, params.window_lines, params.zipf_theta));
+    } else if (strcmp(name, "gaussian") == 0) {
+        return std::unique_ptr<AccessPattern>(new GaussianPattern(max_base, params.hot_center, params.hot_width));
+    } else if (strcmp(name, "mixed") == 0) {
+        MixedPattern* mixed = new MixedPattern(max_base, params.phase_iterations);
+        const char* phases[] = { "sequential", "random", "zipfian", "gaussian" };
+        for (size_t i = 0; i < sizeof(phases) / sizeof(phases[0]); i++) {
+            mixed->add_phase(make_access_pattern(phases[i], size, params));
+        }
+        return std::unique_ptr<AccessPattern>(mixed);
+    }
+    printf("Unknown access pattern: %s\n", name);
+    return nullptr;
+}
+
+#endif // ACCESS_PATTERN_H
@@ -0,0 +1,228 @@
+#ifndef ALLOCATORS_H
+#define ALLOCATORS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h> // for mmap, madvise
+#include <cstdint> // for uintptr_t
+#include <memory_resource>
+#include <vector>
+
+// allocators to compare against malloc, both as the source of one big
+// region and of many small objects. all of them hand out memory with
+// allocate(size) / deallocate(p, size) and drop everything with release().
+// none are thread safe; each driver thread would own its own.
+
+// chunks come straight from mmap, 2 MiB aligned and THP eligible, so the
+// allocators' own pages are not at the mercy of the heap's layout.
+#define ALLOCATOR_CHUNK (64UL * 1024 * 1024)
+#define ALLOCATOR_CHUNK_ALIGN (2UL * 1024 * 1024)
+#define ALLOCATOR_ALIGN 16
+
+static inline size_t round_up(size_t n, size_t align) {
+    return (n + align - 1) & ~(align - 1);
+}
+
+static inline char* map_chunk(size_t size) {
+    size_t len = size + ALLOCATOR_CHUNK_ALIGN;
+    char* raw = (char*) mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        perror("Oh no. Chunk Allocation Failed.");
+        return nullptr;
+    }
+    char* p = (char*) round_up((uintptr_t) raw, ALLOCATOR_CHUNK_ALIGN);
+    if (p > raw) {
+        munmap(raw, p - raw);
+    }
+    if (raw + len > p + size) {
+        munmap(p + size, raw + len - (p + size));
+    }
+    madvise(p, size, MADV_HUGEPAGE);
+    return p;
+}
+
+struct mapped_chunk {
+    char* p;
+    size_t size;
+};
+
+// plain malloc / free, the baseline.
+class MallocAllocator {
+public:
+    void* allocate(size_t size) { return malloc(size); }
+    void deallocate(void* p, size_t) { free(p); }
+    void release() {}
+};
+
+// bump pointer arena: allocation is an add and a compare, deallocation is a
+// no-op and release() unmaps every chunk at once. objects allocated
+// together sit together, which is the locality argument for arenas.
+class BumpArena {
+public:
+    BumpArena() : cur_(nullptr), end_(nullptr) {}
+    ~BumpArena() { release(); }
+
+    void* allocate(size_t size) {
+        size = round_up(size, ALLOCATOR_ALIGN);
+        if (cur_ == nullptr || (size_t) (end_ - cur_) < size) {
+            size_t chunk = size > ALLOCATOR_CHUNK ? round_up(size, ALLOCATOR_CHUNK_ALIGN) : ALLOCATOR_CHUNK;
+            char* p = map_chunk(chunk);
+            if (p == nullptr) {
+                return nullptr;
+            }
+            mapped_chunk c = { p, chunk };
+            chunks_.push_back(c);
+            cur_ = p;
+            end_ = p + chunk;
+        }
+        void* p = cur_;
+        cur_ += size;
+        return p;
+    }
+
+    void deallocate(void*, size_t) {}
+
+    void release() {
+        for (size_t i = 0; i < chunks_.size(); i++) {
+            munmap(chunks_[i].p, chunks_[i].size);
+        }
+        chunks_.clear();
+        cur_ = end_ = nullptr;
+    }
+
+private:
+    char* cur_;
+    char* end_;
+    std::vector<mapped_chunk> chunks_;
+};
+
+// fixed size classes, each a free list threaded through its free slots and
+// refilled a slab at a time from the chunks. sizes above the largest class
+// go to their own chunk (the region case).
+#define SLAB_NUM_CLASSES 9
+#define SLAB_BYTES (64 * 1024)
+
+class SlabPool {
+public:
+    SlabPool() : cur_(nullptr), end_(nullptr) {
+        for (int c = 0; c < SLAB_NUM_CLASSES; c++) {
+            free_[c] = nullptr;
+        }
+    }
+    ~SlabPool() { release(); }
+
+    // 16, 32, 64, ... 4096 bytes.
+    static int size_class(size_t size) {
+        int c = 0;
+        size_t cap = 16;
+        while (cap < size && c < SLAB_NUM_CLASSES) {
+            cap <<= 1;
+            c++;
+        }
+        return c;
+    }
+
+    void* allocate(size_t size) {
+        int c = size_class(size);
+        if (c >= SLAB_NUM_CLASSES) {
+            size_t len = round_up(size, ALLOCATOR_CHUNK_ALIGN);
+            char* p = map_chunk(len);
+            if (p != nullptr) {
+                mapped_chunk m = { p, len };
+                large_.push_back(m);
+            }
+            return p;
+        }
+        if (free_[c] == nullptr && !refill(c)) {
+            return nullptr;
+        }
+        void* p = free_[c];
+        free_[c] = *(void**) p;
+        return p;
+    }
+
+    void deallocate(void* p, size_t size) {
+        int c = size_class(size);
+        if (c >= SLAB_NUM_CLASSES) {
+            for (size_t i = 0; i < large_.size(); i++) {
+                if (large_[i].p == p) {
+                    munmap(large_[i].p, large_[i].size);
+                    large_.erase(large_.begin() + i);
+                    break;
+                }
+            }
+            return;
+        }
+        *(void**) p = free_[c];
+        free_[c] = p;
+    }
+
+    void release() {
+        for (size_t i = 0; i < chunks_.size(); i++) {
+            munmap(chunks_[i].p, chunks_[i].size);
+        }
+        for (size_t i = 0; i < large_.size(); i++) {
+            munmap(large_[i].p, large_[i].size);
+        }
+        chunks_.clear();
+        large_.clear();
+        cur_ = end_ = nullptr;
+        for (int c = 0; c < SLAB_NUM_CLASSES; c++) {
+            free_[c] = nullptr;
+        }
+    }
+
+private:
+    // carve one slab into slots of class c, linked in address order so a
+    // fresh slab hands out consecutive slots.
+    bool refill(int c) {
+        if (cur_ == nullptr || (size_t) (end_ - cur_) < SLAB_BYTES) {
+            char* p = map_chunk(ALLOCATOR_CHUNK);
+            if (p == nullptr) {
+                return false;
+            }
+            mapped_chunk m = { p, ALLOCATOR_CHUNK };
+            chunks_.push_back(m);
+            cur_ = p;
+            end_ = p + ALLOCATOR_CHUNK;
+        }
+        size_t slot = (size_t) 16 << c;
+        char* slab = cur_;
+        cur_ += SLAB_BYTES;
+        size_t n = SLAB_BYTES / slot;
+        for (size_t i = 0; i < n; i++) {
+            *(void**) (slab + i * slot) = i + 1 < n ? slab + (i + 1) * slot : free_[c];
+        }
+        free_[c] = slab;
+        return true;
+    }
+
+    void* free_[SLAB_NUM_CLASSES];
+    char* cur_;
+    char* end_;
+    std::vector<mapped_chunk> chunks_;
+    std::vector<mapped_chunk> large_;
+};
+
+// std::pmr resources behind the same interface. the upstream is the
+// default new/delete resource, i.e. malloc for their backing buffers.
+class PmrMonotonicAllocator {
+public:
+    void* allocate(size_t size) { return res_.allocate(size, ALLOCATOR_ALIGN); }
+    void deallocate(void* p, size_t size) { res_.deallocate(p, size, ALLOCATOR_ALIGN); }
+    void release() { res_.release(); }
+private:
+    std::pmr::monotonic_buffer_resource res_;
+};
+
+class PmrPoolAllocator {
+public:
+    void* allocate(size_t size) { return res_.allocate(size, ALLOCATOR_ALIGN); }
+    void deallocate(void* p, size_t size) { res_.deallocate(p, size, ALLOCATOR_ALIGN); }
+    void release() { res_.release(); }
+private:
+    std::pmr::unsynchronized_pool_resource res_;
+};
+
+#endif // ALLOCATORS_H
@@ -3,41 +3,742 @@
 // allows us to use affinity and getcpu() to test.
 #include <sched.h>
 #include <unistd.h>
-#include <iostream>
-#include <numeric> // For std::accumulate
-
-int main() {
-    int cpu_id = 5;
-    pid_t pid = 0;
-    cpu_set_t mask;
-    CPU_ZERO(&mask);
-    CPU_SET(cpu_id, &mask);
-    size_t cpusetsize = sizeof(mask);
-    if(sched_setaffinity(pid, cpusetsize, &mask) == -1) {
+#include <getopt.h> // for getopt_long
+#include <malloc.h> // for mallopt, mallinfo2, malloc_trim
+#include <signal.h>
+#include <string.h>
+#include <time.h> // for nanosleep
+#include <sys/wait.h> // for waitpid
+#include <cstdint> // for uint64_t
+#include <algorithm> // for std::sort
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mem_access.h" // for pin_to_cpu, now_seconds
+#include "pointer_chase.h" // for read_tsc, tsc_per_ns
+#include "rng.h"
+#include "timeseries.h" // for statm_rss_kb
+#include "topology.h"
+#include "trial_stats.h" // for percentile
+
+// allocation churn generator, the malloc -> fill -> free loop grown into a
+// workload that fragments the heap the way a long running service does.
+// each producer thread keeps a live set of about --live / threads bytes:
+// every op picks a size from the --sizes distribution, frees victims
+// (oldest, newest or random, --lifetime) until the new object fits, then
+// mallocs and fills it. ops run LATENCY_SAMPLE_EVERY at a time, so the
+// frees and the mallocs of a batch are each timed as one. with --consumers
+// the victims are handed to consumer threads and freed there, so memory
+// goes back to another thread's arena. --pattern shapes the live set over time:
+//   steady    the live set stays at --live
+//   sawtooth  every --phase-ops allocations it drops to 1/8 and regrows,
+//             leaving the survivors scattered over the peak's pages
+//   drift     sizes double every phase (x1, x2, x4, x8, x1, ...), so the
+//             holes left by the previous phase are the wrong size
+// --long-lived F keeps that fraction of objects until the end (up to half
+// the live set), pinning the pages they sit on.
+//
+// reports allocation and free ns/op, RSS and live bytes over time, and at
+// the end RSS / live bytes (1.0 = no overhead), malloc's free heap bytes
+// and the RSS left after malloc_trim. --sweep reruns the workload in a
+// fresh process per glibc tunable setting, since M_ARENA_MAX and
+// M_MMAP_THRESHOLD only take effect before the heap is in use.
+//   ./background_activity --sizes mixed --threads 4 --consumers 2 --pattern sawtooth --sweep
+
+// producer victims queued locally before they are handed to a consumer.
+#define HANDOFF_BATCH 256
+// a consumer queue longer than this makes its producers wait.
+#define QUEUE_LIMIT (1 << 20)
+// allocations are made and timed LATENCY_SAMPLE_EVERY at a time, and the
+// first of each batch also on its own, kept for percentiles.
+#define LATENCY_SAMPLE_EVERY 64
+// back-to-back fenced tsc reads taken for the timer's own cost.
+#define TSC_BASELINE_READS 1000
+// how often the main thread samples RSS for the peak.
+#define RSS_POLL_SECONDS 0.05
+
+enum churn_pattern { PATTERN_STEADY, PATTERN_SAWTOOTH, PATTERN_DRIFT };
+enum churn_lifetime { LIFETIME_FIFO, LIFETIME_LIFO, LIFETIME_RANDOM };
+
+// SIZE:WEIGHT classes; each allocation is uniform in (SIZE / 2, SIZE].
+struct size_class {
+    size_t size;
+    double weight;
+};
+
+struct size_distribution {
+    const char* name;
+    const char* spec;
+};
+
+// mixed and large reach past glibc's default 128 KiB mmap threshold.
+static const size_distribution SIZE_DISTRIBUTIONS[] = {
+    {"small", "16:30,32:25,64:20,128:12,256:8,512:5"},
+    {"mixed", "32:40,96:20,256:15,1K:10,4K:8,32K:5,256K:2"},
+    {"large", "4K:30,64K:30,256K:25,1M:15"},
+};
+
+static const size_t NUM_SIZE_DISTRIBUTIONS = sizeof(SIZE_DISTRIBUTIONS) / sizeof(SIZE_DISTRIBUTIONS[0]);
+
+// one glibc tunable setting, param 0 for none.
+struct malloc_tunable {
+    const char* label;
+    int param;
+    long value;
+};
+
+static const malloc_tunable TUNABLE_SWEEP[] = {
+    {"default", 0, 0},
+    {"mmap_threshold=32K", M_MMAP_THRESHOLD, 32 * 1024},
+    {"mmap_threshold=128K", M_MMAP_THRESHOLD, 128 * 1024},
+    {"mmap_threshold=1M", M_MMAP_THRESHOLD, 1024 * 1024},
+    {"mmap_threshold=32M", M_MMAP_THRESHOLD, 32 * 1024 * 1024},
+    {"arena_max=1", M_ARENA_MAX, 1},
+    {"arena_max=2", M_ARENA_MAX, 2},
+    {"arena_max=8", M_ARENA_MAX, 8},
+    {"trim_threshold=4K", M_TRIM_THRESHOLD, 4096},
+    {"trim_threshold=1M", M_TRIM_THRESHOLD, 1024 * 1024},
+    {"trim_threshold=64M", M_TRIM_THRESHOLD, 64 * 1024 * 1024},
+};
+
+static const size_t NUM_TUNABLE_SWEEP = sizeof(TUNABLE_SWEEP) / sizeof(TUNABLE_SWEEP[0]);
+
+std::vector<size_class> opt_sizes;
+const char* opt_sizes_name = "small";
+long opt_live = 256L * 1024 * 1024;   // bytes, over all producers
+int opt_threads = 1;                  // producers
+int opt_consumers = 0;                // 0 = producers free their own
+churn_pattern opt_pattern = PATTERN_STEADY;
+churn_lifetime opt_lifetime = LIFETIME_RANDOM;
+long opt_phase_ops = 1L << 20;        // allocations per producer per phase
+double opt_long_lived = 0;
+std::vector<int> opt_cpus;            // empty = from topology
+double opt_duration = 10;             // seconds, 0 = until signalled
+double opt_report_interval = 1;       // seconds, 0 = only at the end
+std::vector<malloc_tunable> opt_tunables;
+int opt_sweep = 0;
+
+static volatile sig_atomic_t stopped = 0;
+
+static void on_stop(int) { stopped = 1; }
+
+// "64K", "256M", "8G" or plain bytes. 0 on a malformed size.
+static long parse_size(const char* s, char** rest) {
+    char* end;
+    long long v = strtoll(s, &end, 0);
+    switch (*end) {
+        case 'k': case 'K': v <<= 10; end++; break;
+        case 'm': case 'M': v <<= 20; end++; break;
+        case 'g': case 'G': v <<= 30; end++; break;
+        default: break;
+    }
+    *rest = end;
+    return v > 0 ? (long) v : 0;
+}
+
+static long parse_size(const char* s) {
+    char* end;
+    long v = parse_size(s, &end);
+    return *end == '\0' ? v : 0;
+}
+
+// a distribution name, or "SIZE:WEIGHT,..." e.g. "64:90,4K:10".
+static bool parse_sizes(const char* s, std::vector<size_class>& classes) {
+    for (size_t i = 0; i < NUM_SIZE_DISTRIBUTIONS; i++) {
+        if (strcmp(s, SIZE_DISTRIBUTIONS[i].name) == 0) {
+            s = SIZE_DISTRIBUTIONS[i].spec;
+            break;
+        }
+    }
+    classes.clear();
+    while (*s != '\0') {
+        char* end;
+        size_class c;
+        c.size = (size_t) parse_size(s, &end);
+        if (c.size == 0 || *end != ':') {
+            return false;
+        }
+        c.weight = strtod(end + 1, &end);
+        if (c.weight <= 0 || (*end != ',' && *end != '\0')) {
+            return false;
+        }
+        classes.push_back(c);
+        s = *end == ',' ? end + 1 : end;
+    }
+    return !classes.empty();
+}
+
+static void usage(const char* argv0) {
+    printf("usage: %s [options]\n", argv0);
+    printf("  --sizes DIST           size classes: small, mixed, large or SIZE:WEIGHT,...\n");
+    printf("                         e.g. 64:90,4K:10 (default small)\n");
+    printf("  --live BYTES           live set over all producers, K/M/G suffixes (default 256M)\n");
+    printf("  --threads N            producer threads (default 1)\n");
+    printf("  --consumers N          threads that free the producers' objects, 0 = producers\n");
+    printf("                         free their own (default 0)\n");
+    printf("  --lifetime NAME        which object dies first: fifo, lifo or random (default random)\n");
+    printf("  --pattern NAME         steady, sawtooth or drift (default steady)\n");
+    printf("  --phase-ops N          allocations per producer per phase (default 1048576)\n");
+    printf("  --long-lived F         fraction of objects kept until the end (default 0)\n");
+    printf("  --cpus LIST            cpus, e.g. 4 or 0-3,8 (default: every core but the one\n");
+    printf("                         do_mem_access measures on)\n");
+    printf("  --duration S           seconds per run, 0 = until signalled (default 10)\n");
+    printf("  --report-interval S    RSS / live report period, 0 = only at the end (default 1)\n");
+    printf("  --mmap-threshold BYTES  --arena-max N  --trim-threshold BYTES\n");
+    printf("                         glibc tunables, set with mallopt before the run\n");
+    printf("  --sweep                one run per tunable setting, each in a fresh process\n");
+}
+
+static bool parse_options(int argc, char** argv) {
+    static const struct option options[] = {
+        {"sizes", required_argument, nullptr, 's'},
+        {"live", required_argument, nullptr, 'l'},
+        {"threads", required_argument, nullptr, 't'},
+        {"consumers", required_argument, nullptr, 'n'},
+        {"lifetime", required_argument, nullptr, 'f'},
+        {"pattern", required_argument, nullptr, 'p'},
+        {"phase-ops", required_argument, nullptr, 'o'},
+        {"long-lived", required_argument, nullptr, 'g'},
+        {"cpus", required_argument, nullptr, 'c'},
+        {"duration", required_argument, nullptr, 'd'},
+        {"report-interval", required_argument, nullptr, 'i'},
+        {"mmap-threshold", required_argument, nullptr, 'M'},
+        {"arena-max", required_argument, nullptr, 'A'},
+        {"trim-threshold", required_argument, nullptr, 'T'},
+        {"sweep", no_argument, nullptr, 'w'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0},
+    };
+    if (!parse_sizes(opt_sizes_name, opt_sizes)) {
+        return false;
+    }
+    int c;
+    while ((c = getopt_long(argc, argv, "", options, nullptr)) != -1) {
+        switch (c) {
+            case 's':
+                opt_sizes_name = optarg;
+                if (!parse_sizes(optarg, opt_sizes)) {
+                    printf("Bad size distribution: %s\n", optarg);
+                    return false;
+                }
+                break;
+            case 'l':
+                opt_live = parse_size(optarg);
+                if (opt_live == 0) {
+                    printf("Bad size: %s\n", optarg);
+                    return false;
+                }
+                break;
+            case 't': opt_threads = atoi(optarg); break;
+            case 'n': opt_consumers = atoi(optarg); break;
+            case 'f':
+                if (strcmp(optarg, "fifo") == 0) {
+                    opt_lifetime = LIFETIME_FIFO;
+                } else if (strcmp(optarg, "lifo") == 0) {
+                    opt_lifetime = LIFETIME_LIFO;
+                } else if (strcmp(optarg, "random") == 0) {
+                    opt_lifetime = LIFETIME_RANDOM;
+                } else {
+                    printf("Unknown lifetime: %s\n", optarg);
+                    return false;
+                }
+                break;
+            case 'p':
+                if (strcmp(optarg, "steady") == 0) {
+                    opt_pattern = PATTERN_STEADY;
+                } else if (strcmp(optarg, "sawtooth") == 0) {
+                    opt_pattern = PATTERN_SAWTOOTH;
+                } else if (strcmp(optarg, "drift") == 0) {
+                    opt_pattern = PATTERN_DRIFT;
+                } else {
+                    printf("Unknown pattern: %s\n", optarg);
+                    return false;
+                }
+                break;
+            case 'o': opt_phase_ops = atol(optarg); break;
+            case 'g': opt_long_lived = atof(optarg); break;
+            case 'c':
+                if (!parse_cpu_list(optarg, opt_cpus)) {
+                    printf("Bad cpu list: %s\n", optarg);
+                    return false;
+                }
+                break;
+            case 'd': opt_duration = atof(optarg); break;
+            case 'i': opt_report_interval = atof(optarg); break;
+            case 'M': case 'A': case 'T': {
+                malloc_tunable t;
+                t.label = c == 'M' ? "mmap_threshold" : c == 'A' ? "arena_max" : "trim_threshold";
+                t.param = c == 'M' ? M_MMAP_THRESHOLD : c == 'A' ? M_ARENA_MAX : M_TRIM_THRESHOLD;
+                t.value = c == 'A' ? atol(optarg) : parse_size(optarg);
+                if (t.value <= 0) {
+                    printf("Bad %s: %s\n", t.label, optarg);
+                    return false;
+                }
+                opt_tunables.push_back(t);
+                break;
+            }
+            case 'w': opt_sweep = 1; break;
+            default:
+                usage(argv[0]);
+                return false;
+        }
+    }
+    if (opt_threads < 1 || opt_consumers < 0 || opt_phase_ops < 1) {
+        printf("Threads and phase ops must be positive, consumers non-negative.\n");
+        return false;
+    }
+    if (opt_long_lived < 0 || opt_long_lived > 1 || opt_duration < 0) {
+        printf("Long-lived fraction must be in [0, 1] and duration non-negative.\n");
+        return false;
+    }
+    if (opt_sweep && opt_duration == 0) {
+        printf("A sweep needs a --duration.\n");
+        return false;
+    }
+    return true;
+}
+
+struct live_object {
+    char* p;
+    size_t size;
+};
+
+// one per producer or consumer, on its own lines. ops and live_bytes are
+// read by the reporter while the run is going; the rest only afterwards.
+struct alignas(128) churn_counters {
+    std::atomic<uint64_t> ops;
+    std::atomic<int64_t> live_bytes;    // a consumer's goes negative
+    uint64_t alloc_ticks;
+    uint64_t frees;
+    uint64_t free_ticks;
+    bool failed;
+};
+
+// victims on their way from producers to one consumer.
+struct free_queue {
+    std::mutex m;
+    std::vector<live_object> items;
+};
+
+struct churn_state {
+    std::vector<churn_counters> counters;           // producers, then consumers
+    std::vector<std::deque<live_object> > pools;    // per producer, freed by the main thread at the end
+    std::vector<std::vector<live_object> > keep;    // long-lived, per producer
+    std::vector<std::vector<double> > latency_ns;   // sampled allocations, per producer
+    std::vector<free_queue> queues;                 // per consumer
+    std::atomic<bool> done;
+    std::atomic<bool> producers_done;
+};
+
+// frees are timed a batch at a time; one tsc pair per free would cost about
+// as much as a small free itself.
+static inline void free_batch(const std::vector<live_object>& batch, churn_counters& c) {
+    if (batch.empty()) {
+        return;
+    }
+    int64_t bytes = 0;
+    uint64_t t0 = read_tsc();
+    for (size_t i = 0; i < batch.size(); i++) {
+        free(batch[i].p);
+    }
+    c.free_ticks += read_tsc() - t0;
+    for (size_t i = 0; i < batch.size(); i++) {
+        bytes += (int64_t) batch[i].size;
+    }
+    c.frees += batch.size();
+    c.live_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+// rdtsc is not ordered against the loads and stores around it; the latency
+// samples fence both sides so the malloc between them is what is timed.
+static inline uint64_t read_tsc_fenced() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_lfence();
+    uint64_t t = __rdtsc();
+    _mm_lfence();
+    return t;
+#else
+    return read_tsc();
+#endif
+}
+
+// ticks a pair of fenced reads costs with nothing between them, the least
+// of TSC_BASELINE_READS tries. subtracted from every latency sample.
+static inline uint64_t tsc_pair_baseline() {
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < TSC_BASELINE_READS; i++) {
+        uint64_t t0 = read_tsc_fenced();
+        uint64_t t1 = read_tsc_fenced();
+        best = std::min(best, t1 - t0);
+    }
+    return best;
+}
+
+static void producer(churn_state& st, int t, int cpu, double ticks_per_ns, uint64_t tsc_baseline) {
+    if (cpu >= 0 && pin_to_cpu(cpu) == -1) {
+        perror("Oh no. CPU Set Operation Failed.");
+    }
+    churn_counters& c = st.counters[t];
+    std::deque<live_object>& pool = st.pools[t];
+    std::vector<live_object>& keep = st.keep[t];
+    std::vector<double>& latency = st.latency_ns[t];
+    Xoshiro256ss rng((uint64_t) getpid() * 1000003 + t);
+    double total_weight = 0;
+    for (size_t i = 0; i < opt_sizes.size(); i++) {
+        total_weight += opt_sizes[i].weight;
+    }
+    int64_t high = opt_live / opt_threads;
+    int64_t live = 0, kept = 0;
+    std::vector<live_object> outgoing;
+    free_queue* queue = opt_consumers > 0 ? &st.queues[t % opt_consumers] : nullptr;
+
+    std::vector<live_object> victims;
+    size_t sizes[LATENCY_SAMPLE_EVERY];
+    char* objects[LATENCY_SAMPLE_EVERY];
+
+    for (uint64_t op = 0; !st.done.load(std::memory_order_relaxed) && !c.failed; op += LATENCY_SAMPLE_EVERY) {
+        // pick the batch's sizes and make room under the target for each,
+        // oldest / newest / any victim first.
+        for (int j = 0; j < LATENCY_SAMPLE_EVERY; j++) {
+            long phase = (long) ((op + j) / opt_phase_ops);
+            int64_t target = opt_pattern == PATTERN_SAWTOOTH && phase % 2 == 1 ? high / 8 : high;
+            size_t scale = opt_pattern == PATTERN_DRIFT ? (size_t) 1 << (phase % 4) : 1;
+
+            double w = rng.unit() * total_weight;
+            size_t k = 0;
+            while (k + 1 < opt_sizes.size() && w >= opt_sizes[k].weight) {
+                w -= opt_sizes[k].weight;
+                k++;
+            }
+            size_t hi = opt_sizes[k].size * scale;
+            size_t size = hi / 2 + 1 + rng.below(hi - hi / 2);
+            sizes[j] = size;
+
+            while (!pool.empty() && live + (int64_t) size > target) {
+                live_object victim;
+                if (opt_lifetime == LIFETIME_FIFO) {
+                    victim = pool.front();
+                    pool.pop_front();
+                } else if (opt_lifetime == LIFETIME_LIFO) {
+                    victim = pool.back();
+                    pool.pop_back();
+                } else {
+                    size_t i = rng.below(pool.size());
+                    victim = pool[i];
+                    pool[i] = pool.back();
+                    pool.pop_back();
+                }
+                live -= victim.size;
+                if (queue == nullptr) {
+                    victims.push_back(victim);
+                    continue;
+                }
+                outgoing.push_back(victim);
+                if (outgoing.size() >= HANDOFF_BATCH) {
+                    for (;;) {
+                        std::unique_lock<std::mutex> lock(queue->m);
+                        if (queue->items.size() < QUEUE_LIMIT || st.done.load(std::memory_order_relaxed)) {
+                            queue->items.insert(queue->items.end(), outgoing.begin(), outgoing.end());
+                            break;
+                        }
+                        lock.unlock();
+                        std::this_thread::yield();
+                    }
+                    outgoing.clear();
+                }
+            }
+            live += size;
+        }
+        free_batch(victims, c);
+        victims.clear();
+
+        // the first malloc between its own fenced pair for the percentiles,
+        // the whole batch under one pair for the mean.
+        uint64_t t0 = read_tsc_fenced();
+        objects[0] = (char*) malloc(sizes[0]);
+        uint64_t t1 = read_tsc_fenced();
+        for (int j = 1; j < LATENCY_SAMPLE_EVERY; j++) {
+            objects[j] = (char*) malloc(sizes[j]);
+        }
+        uint64_t t2 = read_tsc_fenced();
+        c.alloc_ticks += t2 - t0 > tsc_baseline ? t2 - t0 - tsc_baseline : 0;
+        uint64_t sample = t1 - t0;
+        latency.push_back((sample > tsc_baseline ? sample - tsc_baseline : 0) / ticks_per_ns);
+
+        int64_t bytes = 0;
+        uint64_t made = 0;
+        for (int j = 0; j < LATENCY_SAMPLE_EVERY; j++) {
+            if (objects[j] == nullptr) {
+                c.failed = true;
+                continue;
+            }
+            made++;
+            size_t size = sizes[j];
+            memset(objects[j], (int) (op + j), size);
+            live_object o = { objects[j], size };
+            bytes += size;
+            if (opt_long_lived > 0 && kept + (int64_t) size <= high / 2 && rng.unit() < opt_long_lived) {
+                // counted against the target, but never a victim.
+                keep.push_back(o);
+                kept += size;
+            } else {
+                pool.push_back(o);
+            }
+        }
+        c.live_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        c.ops.fetch_add(made, std::memory_order_relaxed);
+    }
+    if (queue != nullptr && !outgoing.empty()) {
+        std::lock_guard<std::mutex> lock(queue->m);
+        queue->items.insert(queue->items.end(), outgoing.begin(), outgoing.end());
+    }
+}
+
+static void consumer(churn_state& st, int n, int cpu) {
+    if (cpu >= 0 && pin_to_cpu(cpu) == -1) {
         perror("Oh no. CPU Set Operation Failed.");
+    }
+    churn_counters& c = st.counters[opt_threads + n];
+    free_queue& queue = st.queues[n];
+    std::vector<live_object> batch;
+    for (;;) {
+        // read before draining, so nothing pushed before the producers
+        // finished can be left behind.
+        bool last = st.producers_done.load(std::memory_order_acquire);
+        {
+            std::lock_guard<std::mutex> lock(queue.m);
+            batch.swap(queue.items);
+        }
+        free_batch(batch, c);
+        if (batch.empty()) {
+            if (last) {
+                break;
+            }
+            std::this_thread::yield();
+        }
+        batch.clear();
+    }
+}
+
+static int64_t live_bytes(const churn_state& st) {
+    int64_t sum = 0;
+    for (size_t i = 0; i < st.counters.size(); i++) {
+        sum += st.counters[i].live_bytes.load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+static uint64_t total_ops(const churn_state& st) {
+    uint64_t sum = 0;
+    for (int t = 0; t < opt_threads; t++) {
+        sum += st.counters[t].ops.load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+static void print_summary_header() {
+    printf("%-20s %8s %9s %9s %9s %9s %9s %9s %8s %9s %9s\n", "Config", "Mops/s", "Alloc ns", "Free ns",
+           "Alloc P99", "Peak MiB", "Live MiB", "RSS MiB", "RSS/Live", "Heap Free", "Trim MiB");
+}
+
+// one full run under the tunables already applied; prints one summary row
+// labelled label.
+static int churn(const std::vector<int>& cpus, const char* label, bool quiet) {
+    double ticks_per_ns = tsc_per_ns();
+    uint64_t tsc_baseline = tsc_pair_baseline();
+    int workers = opt_threads + opt_consumers;
+    churn_state st;
+    st.counters = std::vector<churn_counters>(workers);
+    for (int i = 0; i < workers; i++) {
+        st.counters[i].ops = 0;
+        st.counters[i].live_bytes = 0;
+        st.counters[i].alloc_ticks = st.counters[i].frees = st.counters[i].free_ticks = 0;
+        st.counters[i].failed = false;
+    }
+    st.pools.resize(opt_threads);
+    st.keep.resize(opt_threads);
+    st.latency_ns.resize(opt_threads);
+    st.queues = std::vector<free_queue>(opt_consumers);
+    st.done = false;
+    st.producers_done = false;
+
+    std::vector<std::thread> producers, consumers;
+    double start = now_seconds();
+    for (int t = 0; t < opt_threads; t++) {
+        int cpu = cpus.empty() ? -1 : cpus[t % cpus.size()];
+        producers.push_back(std::thread(producer, std::ref(st), t, cpu, ticks_per_ns, tsc_baseline));
+    }
+    for (int n = 0; n < opt_consumers; n++) {
+        int cpu = cpus.empty() ? -1 : cpus[(opt_threads + n) % cpus.size()];
+        consumers.push_back(std::thread(consumer, std::ref(st), n, cpu));
+    }
+
+    // the main thread watches RSS and live bytes until time is up.
+    long peak_kb = 0;
+    double last_report = start;
+    uint64_t last_ops = 0;
+    struct timespec poll = {0, (long) (RSS_POLL_SECONDS * 1e9)};
+    while (!stopped) {
+        nanosleep(&poll, nullptr);
+        double now = now_seconds();
+        long rss_kb = statm_rss_kb();
+        peak_kb = std::max(peak_kb, rss_kb);
+        if (!quiet && opt_report_interval > 0 && now - last_report >= opt_report_interval) {
+            uint64_t ops = total_ops(st);
+            double live_mib = live_bytes(st) / (1024.0 * 1024.0);
+            printf("%7.1f s: RSS %.1f MiB, live %.1f MiB, RSS/live %.2f, %.3f Mops/s\n", now - start,
+                   rss_kb / 1024.0, live_mib, live_mib > 0 ? rss_kb / 1024.0 / live_mib : 0,
+                   (ops - last_ops) / (now - last_report) / 1e6);
+            fflush(stdout);
+            last_report = now;
+            last_ops = ops;
+        }
+        if (opt_duration > 0 && now - start >= opt_duration) {
+            break;
+        }
+    }
+    st.done = true;
+    for (size_t t = 0; t < producers.size(); t++) {
+        producers[t].join();
+    }
+    double elapsed = now_seconds() - start;
+    st.producers_done.store(true, std::memory_order_release);
+    for (size_t n = 0; n < consumers.size(); n++) {
+        consumers[n].join();
+    }
+
+    // the heap as the run left it, then what malloc_trim can give back.
+    long rss_kb = statm_rss_kb();
+    peak_kb = std::max(peak_kb, rss_kb);
+    double live_mib = live_bytes(st) / (1024.0 * 1024.0);
+#if __GLIBC_PREREQ(2, 33)
+    double heap_free_mib = mallinfo2().fordblks / (1024.0 * 1024.0);
+#else
+    double heap_free_mib = (unsigned int) mallinfo().fordblks / (1024.0 * 1024.0);
+#endif
+    malloc_trim(0);
+    long trimmed_kb = statm_rss_kb();
+
+    uint64_t ops = 0, alloc_ticks = 0, frees = 0, free_ticks = 0;
+    bool failed = false;
+    std::vector<double> latency;
+    for (int i = 0; i < workers; i++) {
+        const churn_counters& c = st.counters[i];
+        ops += c.ops.load();
+        alloc_ticks += c.alloc_ticks;
+        frees += c.frees;
+        free_ticks += c.free_ticks;
+        failed |= c.failed;
+    }
+    for (int t = 0; t < opt_threads; t++) {
+        latency.insert(latency.end(), st.latency_ns[t].begin(), st.latency_ns[t].end());
+    }
+    std::sort(latency.begin(), latency.end());
+    if (!quiet) {
+        print_summary_header();
+    }
+    printf("%-20s %8.3f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %8.2f %9.1f %9.1f%s\n", label, ops / elapsed / 1e6,
+           ops ? alloc_ticks / ticks_per_ns / ops : 0, frees ? free_ticks / ticks_per_ns / frees : 0,
+           latency.empty() ? 0 : percentile(latency, 0.99), peak_kb / 1024.0, live_mib, rss_kb / 1024.0,
+           live_mib > 0 ? rss_kb / 1024.0 / live_mib : 0, heap_free_mib, trimmed_kb / 1024.0,
+           failed ? "  (malloc failed)" : "");
+    fflush(stdout);
+
+    for (int t = 0; t < opt_threads; t++) {
+        for (size_t i = 0; i < st.pools[t].size(); i++) {
+            free(st.pools[t][i].p);
+        }
+        for (size_t i = 0; i < st.keep[t].size(); i++) {
+            free(st.keep[t][i].p);
+        }
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static bool apply_tunable(const malloc_tunable& t) {
+    if (t.param != 0 && mallopt(t.param, (int) t.value) != 1) {
+        printf("Oh no. mallopt %s = %ld Failed.\n", t.label, t.value);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (!parse_options(argc, argv)) {
         return EXIT_FAILURE;
     }
 
-    while (true) {
-        // allocate some memory
-        size_t arraySize = 1000000;
-        int* array = (int*) malloc(arraySize * sizeof(int));
-        if (array == nullptr) {
-            printf("Failed to allocate for cache flush.\n");
-            return EXIT_FAILURE;
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    // stay off the core do_mem_access measures on, if there is another.
+    std::vector<int> cpus = opt_cpus;
+    if (cpus.empty()) {
+        Topology topo;
+        int measured = topo.measure_cpu();
+        std::vector<int> spread = topo.spread();
+        for (size_t i = 0; i < spread.size(); i++) {
+            if (spread[i] != measured && !topo.smt_siblings(spread[i], measured)) {
+                cpus.push_back(spread[i]);
+            }
         }
-        // fill the array with some values
-        for (size_t i = 0; i < arraySize; i++) {
-            array[i] = i;
+        if (cpus.empty()) {
+            printf("No cpu besides the measured one, not pinning.\n");
         }
-        // iterate over the array and sum the values
-        for (size_t i = 0; i < arraySize; i++) {
-            array[i] = array[i] + 1;
+    }
+    if (!cpus.empty()) {
+        printf("Pinning to cpus");
+        for (size_t i = 0; i < cpus.size(); i++) {
+            printf("%s%d", i ? "," : " ", cpus[i]);
         }
-        // free the memory
-        free(array);
-        return 0;
-        
+        printf("%s.\n", opt_cpus.empty() ? " (from topology)" : "");
     }
 
-}
\ No newline at end of file
+    std::string label;
+    for (size_t i = 0; i < opt_tunables.size(); i++) {
+        if (!apply_tunable(opt_tunables[i])) {
+            return EXIT_FAILURE;
+        }
+        label += (label.empty() ? "" : ",") + std::string(opt_tunables[i].label) + "=" +
+                 std::to_string(opt_tunables[i].value);
+    }
+    printf("Allocation Churn, sizes %s, live %ld MiB, %d producers, %d consumers, %.1f s per run\n",
+           opt_sizes_name, opt_live >> 20, opt_threads, opt_consumers, opt_duration);
+    fflush(stdout);
+
+    if (!opt_sweep) {
+        return churn(cpus, label.empty() ? "default" : label.c_str(), false);
+    }
+
+    // a fresh process per setting: the tunables only bite on a new heap,
+    // and a run's fragmentation must not carry into the next.
+    print_summary_header();
+    fflush(stdout);
+    int result = EXIT_SUCCESS;
+    for (size_t i = 0; i < NUM_TUNABLE_SWEEP && !stopped; i++) {
+        pid_t pid = fork();
+        if (pid == -1) {
+            perror("Error in system call fork");
+            return EXIT_FAILURE;
+        }
+        if (pid == 0) {
+            if (!apply_tunable(TUNABLE_SWEEP[i])) {
+                _exit(EXIT_FAILURE);
+            }
+            _exit(churn(cpus, TUNABLE_SWEEP[i].label, true));
+        }
+        int status;
+        if (waitpid(pid, &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+            result = EXIT_FAILURE;
+        }
+    }
+    printf("------------------------\n");
+    return result;
+}
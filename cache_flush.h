@@ -0,0 +1,238 @@
+#ifndef CACHE_FLUSH_H
+#define CACHE_FLUSH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h> // for mmap, mremap
+#include <cstdint> // for uintptr_t
+#include <algorithm> // for std::sort
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h> // for __get_cpuid_count
+#include <x86intrin.h> // for _mm_clflush, _mm_mfence, _mm_lfence
+#define CACHE_FLUSH_X86 1
+#endif
+
+#include "pointer_chase.h" // for read_tsc
+#include "region.h"
+#include "topology.h"
+
+// eviction buffer when the llc size is unknown.
+#define FLUSH_FALLBACK_LLC (32 * 1024 * 1024)
+// lines sampled by the residual warmth check, one per page of the canary.
+#define FLUSH_PROBE_LINES 256
+
+static inline bool cpu_has_clflushopt() {
+#ifdef CACHE_FLUSH_X86
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return (ebx >> 23) & 1;
+    }
+#endif
+    return false;
+}
+
+// write back and invalidate every line of [p, p + size) from the whole
+// hierarchy. clflushopt where the cpu has it (unordered, so much faster
+// over large ranges), clflush otherwise. false where neither exists.
+static inline bool clflush_range(const char* p, size_t size, bool use_opt) {
+#ifdef CACHE_FLUSH_X86
+    uintptr_t start = (uintptr_t) p & ~((uintptr_t) CACHE_LINE_SIZE - 1);
+    uintptr_t end = (uintptr_t) p + size;
+    _mm_mfence();
+    if (use_opt) {
+        for (uintptr_t a = start; a < end; a += CACHE_LINE_SIZE) {
+            asm volatile("clflushopt %0" : "+m" (*(volatile char*) a));
+        }
+    } else {
+        for (uintptr_t a = start; a < end; a += CACHE_LINE_SIZE) {
+            _mm_clflush((const void*) a);
+        }
+    }
+    _mm_mfence();
+    return true;
+#else
+    (void) p;
+    (void) size;
+    (void) use_opt;
+    return false;
+#endif
+}
+
+// median tsc ticks to load FLUSH_PROBE_LINES lines spread evenly over
+// [p, p + size), each load fenced on both sides so they do not overlap.
+static inline double probe_lines(const char* p, size_t size) {
+    size_t lines = size / CACHE_LINE_SIZE;
+    size_t step = lines / FLUSH_PROBE_LINES > 0 ? lines / FLUSH_PROBE_LINES : 1;
+    std::vector<double> ticks;
+    for (size_t l = 0; l < lines && ticks.size() < FLUSH_PROBE_LINES; l += step) {
+        volatile const char* a = p + l * CACHE_LINE_SIZE;
+#ifdef CACHE_FLUSH_X86
+        _mm_lfence();
+#endif
+        uint64_t c0 = read_tsc();
+#ifdef CACHE_FLUSH_X86
+        _mm_lfence();
+#endif
+        (void) *a;
+#ifdef CACHE_FLUSH_X86
+        _mm_lfence();
+#endif
+        ticks.push_back((double) (read_tsc() - c0));
+    }
+    if (ticks.empty()) {
+        return 0;
+    }
+    std::sort(ticks.begin(), ticks.end());
+    return ticks[ticks.size() / 2];
+}
+
+// what the residual warmth check saw on the canary: probe latency right
+// after the flush, and again straight after (now certainly cached). a ratio
+// near 1 means the flush left hot data warm.
+struct flush_report {
+    double cold_ticks;
+    double warm_ticks;
+    bool flushed_lines;
+    bool remapped;
+};
+
+// evicts the caches between trials by writing a buffer several times the
+// size of the last level cache the topology reports for the measured cpu. the
+// buffer is faulted in once up front so each flush costs cache misses, not
+// page faults. optionally also clflushes the target region (for regions
+// too large to evict by capacity alone, or inclusive/non-inclusive llc
+// quirks) and moves an mmap'd region to a fresh address so its TLB entries
+// and page walk caches start cold too.
+//
+// the warmth check never touches the region: probing it would refill the
+// TLB a remap just emptied and, on a lazily populated region, fault pages
+// in ahead of the walk and time the faults. it probes a pre-faulted canary
+// instead, one line per page, made hot just before the flush and given the
+// same eviction (and clflush) as the region.
+class CacheFlusher {
+public:
+    CacheFlusher() : buffer_(nullptr), size_(0), llc_(0), canary_(nullptr), clflushopt_(false) {}
+    ~CacheFlusher() {
+        free(buffer_);
+        free(canary_);
+    }
+
+    bool init(const Topology& topo, int multiple) {
+        llc_ = topo.llc_size();
+        size_t llc = llc_ > 0 ? llc_ : FLUSH_FALLBACK_LLC;
+        size_ = llc * (multiple > 0 ? multiple : 1);
+        buffer_ = (char*) malloc(size_);
+        if (buffer_ == nullptr) {
+            printf("Failed to allocate for cache flush.\n");
+            return false;
+        }
+        memset(buffer_, 1, size_);
+        canary_ = (char*) aligned_alloc(REGION_PAGE_SIZE, CANARY_BYTES);
+        if (canary_ == nullptr) {
+            printf("Failed to allocate the flush canary.\n");
+            return false;
+        }
+        memset(canary_, 1, CANARY_BYTES);
+        clflushopt_ = cpu_has_clflushopt();
+        return true;
+    }
+
+    void print() const {
+        if (llc_ > 0) {
+            printf("Flush Buffer: %zu MiB (%zu x %zu MiB LLC)\n", size_ >> 20, size_ / llc_, llc_ >> 20);
+        } else {
+            printf("Flush Buffer: %zu MiB (llc size unknown, assumed %d MiB)\n", size_ >> 20,
+                   FLUSH_FALLBACK_LLC >> 20);
+        }
+    }
+
+    size_t buffer_size() const { return size_; }
+
+    // evict by capacity: a read-modify-write of every line, twice, so
+    // adaptive replacement policies cannot keep part of the old contents.
+    void evict() {
+        for (int pass = 0; pass < 2; pass++) {
+            for (size_t i = 0; i < size_; i += CACHE_LINE_SIZE) {
+                buffer_[i] += 1;
+            }
+        }
+        asm volatile("" : : "r" (buffer_) : "memory");
+    }
+
+    // full flush before a trial. p may move when remap is set and the region
+    // is an mmap'd one; release must then be given the returned pointer.
+    char* flush(char* p, size_t size, const region_type& region, bool clflush, bool remap,
+                flush_report& report) {
+        report.flushed_lines = false;
+        report.remapped = false;
+        if (remap) {
+            char* moved = remap_region(p, size, region);
+            report.remapped = moved != p;
+            p = moved;
+        }
+        // the canary stands in for data that was hot before the flush.
+        probe_lines(canary_, CANARY_BYTES);
+        evict();
+        if (clflush) {
+            report.flushed_lines = clflush_range(p, size, clflushopt_);
+            flush_canary();
+        }
+        report.cold_ticks = probe_lines(canary_, CANARY_BYTES);
+        report.warm_ticks = probe_lines(canary_, CANARY_BYTES);
+        // the probe pulled the canary back in; put it out again so it does
+        // not take cache from the walk.
+        flush_canary();
+        return p;
+    }
+
+private:
+    static const size_t CANARY_BYTES = (size_t) FLUSH_PROBE_LINES * REGION_PAGE_SIZE;
+
+    void flush_canary() {
+        for (size_t off = 0; off < CANARY_BYTES; off += REGION_PAGE_SIZE) {
+            clflush_range(canary_ + off, 1, clflushopt_);
+        }
+    }
+
+    // move the mapping to a fresh, huge page aligned address. unmapping the
+    // old range shoots down its TLB entries and the new range has none yet.
+    // heap regions cannot be moved and are returned as is.
+    static char* remap_region(char* p, size_t size, const region_type& region) {
+        if (region.release != munmap_region) {
+            return p;
+        }
+        size_t len = size + HUGE_PAGE_SIZE;
+        char* raw = (char*) mmap(nullptr, len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) {
+            perror("Oh no. Remap Reservation Failed.");
+            return p;
+        }
+        char* target = (char*) (((uintptr_t) raw + HUGE_PAGE_SIZE - 1) & ~((uintptr_t) HUGE_PAGE_SIZE - 1));
+        void* moved = mremap(p, size, size, MREMAP_MAYMOVE | MREMAP_FIXED, target);
+        if (moved == MAP_FAILED) {
+            perror("Oh no. Remap Failed.");
+            munmap(raw, len);
+            return p;
+        }
+        // trim what is left of the reservation around the moved region.
+        if (target > raw) {
+            munmap(raw, target - raw);
+        }
+        size_t mapped = (size + REGION_PAGE_SIZE - 1) & ~((size_t) REGION_PAGE_SIZE - 1);
+        if (target + mapped < raw + len) {
+            munmap(target + mapped, raw + len - (target + mapped));
+        }
+        return (char*) moved;
+    }
+
+    char* buffer_;
+    size_t size_;
+    size_t llc_;
+    char* canary_;
+    bool clflushopt_;
+};
+
+#endif // CACHE_FLUSH_H
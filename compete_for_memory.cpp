@@ -3,97 +3,359 @@
 // allows us to use affinity and getcpu() to test.
 #include <sched.h>
 #include <unistd.h>
-#include <iostream>
-#include <numeric> // For std::accumulate
+#include <getopt.h> // for getopt_long
+#include <signal.h>
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
-#include <unistd.h>
-#include <sys/sysinfo.h>
-#include <sys/time.h>
 #include <sys/resource.h>
-#include <sys/syscall.h>
-#include <sys/types.h>
-#include <sys/wait.h>
 #include <errno.h>
 #include <string.h>
-#include <assert.h>
 #include <time.h>
-#include <math.h>
-// include for mmap
-#include <sys/mman.h>
+#include <cstdint> // for uint64_t
+
+#include "rng.h"
+#include "topology.h"
 
+// a memory pressure co-runner. it maps a region of the target resident size,
+// faults all of it in, then keeps touching pages at a fixed rate with a
+// read/write mix, so a measured benchmark can be run next to a known,
+// repeatable noisy neighbour.
+//
+// handshake: with --ready-file the generator writes its pid to that file
+// once the region is resident and waits for SIGUSR1 before applying
+// pressure; SIGUSR2, SIGINT or SIGTERM stop it. e.g.
+//   ./compete_for_memory --rss 8G --rate 200000 --ready-file /tmp/cfm &
+//   while [ ! -s /tmp/cfm ]; do sleep 0.1; done
+//   kill -USR1 $(cat /tmp/cfm); ./do_mem_access ...; kill -USR2 $(cat /tmp/cfm)
+// without --ready-file it starts right away and runs for --duration seconds
+// (forever when 0).
 
+// pages between clock checks, both for pacing and reporting.
+#define TOUCH_BATCH 1024
+// fixed point write fraction, same scheme as do_mem_access.
+#define WRITE_ONE (1ULL << 32)
 
+long opt_rss = 0;                 // bytes, 0 = half of MemAvailable
+double opt_rate = 0;              // page touches per second, 0 = unthrottled
+double opt_write_fraction = 0.125;
+const char* opt_pattern = "random";
+int opt_cpu = -2;                 // -1 = do not pin, -2 = next to the measured cpu
+double opt_duration = 0;          // seconds, 0 = until stopped
+double opt_report_interval = 1;   // seconds, 0 = only at the end
+const char* opt_ready_file = nullptr;
+int opt_force = 0;                // allow --rss above MemAvailable
 
-// Simple, fast random number generator, here so we can observe it using profiler
-long x = 1, y = 4, z = 7, w = 13;
+static volatile sig_atomic_t started = 0;
+static volatile sig_atomic_t stopped = 0;
 
-long simplerand(void) {
-	long t = x;
-	t ^= t << 11;
-	t ^= t >> 8;
-	x = y;
-	y = z;
-	z = w;
-	w ^= w >> 19;
-	w ^= t;
-	return w;
+static void on_start(int) { started = 1; }
+static void on_stop(int) { stopped = 1; }
+
+// bytes the kernel thinks can be allocated without swapping, from
+// MemAvailable in /proc/meminfo (free pages if that is unreadable).
+long get_mem_available() {
+    char buffer[256];
+    long kb = -1;
+    FILE* file = fopen("/proc/meminfo", "r");
+    if (file != nullptr) {
+        while (fgets(buffer, sizeof(buffer), file) != nullptr) {
+            if (sscanf(buffer, "MemAvailable: %ld kB", &kb) == 1) {
+                break;
+            }
+        }
+        fclose(file);
+    }
+    if (kb < 0) {
+        return sysconf(_SC_AVPHYS_PAGES) * sysconf(_SC_PAGE_SIZE);
+    }
+    return kb * 1024;
 }
 
-long get_mem_size() {
-    long page_sz = sysconf(_SC_PAGE_SIZE);
-    long physical_pages = sysconf(_SC_PHYS_PAGES);
-    return physical_pages * page_sz;
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// resident bytes of this process, from /proc/self/statm.
+static long resident_bytes() {
+    long size = 0, resident = 0;
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (file == nullptr) {
+        return 0;
+    }
+    if (fscanf(file, "%ld %ld", &size, &resident) != 2) {
+        resident = 0;
+    }
+    fclose(file);
+    return resident * sysconf(_SC_PAGE_SIZE);
 }
 
-int compete_for_memory(void* unused) {
-long mem_size = get_mem_size();
-int page_sz = sysconf(_SC_PAGE_SIZE);
-printf("Total memsize is %3.2f GBs\n", (double)mem_size/(1024*1024*1024));
-fflush(stdout);
-char* p = (char*) mmap(NULL, mem_size, PROT_READ | PROT_WRITE,
-                MAP_NORESERVE|MAP_PRIVATE|MAP_ANONYMOUS, -1, (off_t) 0);
-if (p == MAP_FAILED)
-    perror("Failed anon MMAP competition");
-
-int i = 0;
-while(1) {
-    volatile char *a;
-    long r = simplerand() % (mem_size/page_sz);
-    char c;
-    if( i >= mem_size/page_sz ) {
-        i = 0;
-    }
-    // One read and write per page
-    //a = p + i * page_sz; // sequential access
-    a = p + r * page_sz;
-    c += *a;
-    if((i%8) == 0) {
-        *a = 1;
-    }
-    i++;
+// "64K", "256M", "8G" or plain bytes. 0 on a malformed size.
+static long parse_size(const char* s) {
+    char* end;
+    long long v = strtoll(s, &end, 0);
+    switch (*end) {
+        case 'k': case 'K': v <<= 10; end++; break;
+        case 'm': case 'M': v <<= 20; end++; break;
+        case 'g': case 'G': v <<= 30; end++; break;
+        default: break;
+    }
+    return *end == '\0' && v > 0 ? (long) v : 0;
 }
-return 0;
+
+static void usage(const char* argv0) {
+    printf("usage: %s [options]\n", argv0);
+    printf("  --rss BYTES            resident size to hold, K/M/G suffixes (default: half of\n");
+    printf("                         MemAvailable; more than MemAvailable needs --force)\n");
+    printf("  --rate N               page touches per second, 0 = as fast as possible (default 0)\n");
+    printf("  --write-fraction F     fraction of touches that store (default 0.125)\n");
+    printf("  --pattern NAME         random or sequential page order (default random)\n");
+    printf("  --cpu N                cpu to pin to, -1 to not pin (default: another core than\n");
+    printf("                         the one do_mem_access measures on by default)\n");
+    printf("  --duration S           stop after S seconds of pressure, 0 = until signalled\n");
+    printf("  --report-interval S    progress report period, 0 = only at the end (default 1)\n");
+    printf("  --ready-file FILE      write pid here once resident, then wait for SIGUSR1\n");
+    printf("  --force                allow an --rss above MemAvailable (risks the OOM killer)\n");
+}
+
+static bool parse_options(int argc, char** argv) {
+    static const struct option options[] = {
+        {"rss", required_argument, nullptr, 'r'},
+        {"rate", required_argument, nullptr, 't'},
+        {"write-fraction", required_argument, nullptr, 'w'},
+        {"pattern", required_argument, nullptr, 'p'},
+        {"cpu", required_argument, nullptr, 'c'},
+        {"duration", required_argument, nullptr, 'd'},
+        {"report-interval", required_argument, nullptr, 'i'},
+        {"ready-file", required_argument, nullptr, 'f'},
+        {"force", no_argument, nullptr, 'F'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0},
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "", options, nullptr)) != -1) {
+        switch (c) {
+            case 'r':
+                opt_rss = parse_size(optarg);
+                if (opt_rss == 0) {
+                    printf("Bad size: %s\n", optarg);
+                    return false;
+                }
+                break;
+            case 't': opt_rate = atof(optarg); break;
+            case 'w': opt_write_fraction = atof(optarg); break;
+            case 'p': opt_pattern = optarg; break;
+            case 'c': opt_cpu = atoi(optarg); break;
+            case 'd': opt_duration = atof(optarg); break;
+            case 'i': opt_report_interval = atof(optarg); break;
+            case 'f': opt_ready_file = optarg; break;
+            case 'F': opt_force = 1; break;
+            default:
+                usage(argv[0]);
+                return false;
+        }
+    }
+    if (strcmp(opt_pattern, "random") != 0 && strcmp(opt_pattern, "sequential") != 0) {
+        printf("Unknown pattern: %s\n", opt_pattern);
+        return false;
+    }
+    if (opt_write_fraction < 0 || opt_write_fraction > 1 || opt_rate < 0) {
+        printf("Write fraction must be in [0, 1] and rate non-negative.\n");
+        return false;
+    }
+    return true;
+}
+
+// counters for one reporting period.
+struct pressure_sample {
+    double time;
+    uint64_t touches;
+    long minflt;
+    long majflt;
+};
+
+static pressure_sample take_sample(uint64_t touches) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    pressure_sample s;
+    s.time = now_seconds();
+    s.touches = touches;
+    s.minflt = ru.ru_minflt;
+    s.majflt = ru.ru_majflt;
+    return s;
+}
+
+static void report(const char* label, const pressure_sample& from, const pressure_sample& to) {
+    double dt = to.time - from.time;
+    if (dt <= 0) {
+        return;
+    }
+    printf("%s: RSS %.1f MiB, %.0f touches/s, %.0f minor faults/s, %.0f major faults/s\n", label,
+           resident_bytes() / (1024.0 * 1024.0), (to.touches - from.touches) / dt,
+           (to.minflt - from.minflt) / dt, (to.majflt - from.majflt) / dt);
+    fflush(stdout);
 }
 
-int main() {
-    // Set the CPU affinity to CPU 6
-    fork() 
-
-    int cpu_id = 6;
-    pid_t pid = 0;
-    cpu_set_t mask;
-    CPU_ZERO(&mask);
-    CPU_SET(cpu_id, &mask);
-    size_t cpusetsize = sizeof(mask);
-    if(sched_setaffinity(pid, cpusetsize, &mask) == -1) {
-        perror("Oh no. CPU Set Operation Failed.");
+int compete_for_memory(long mem_size) {
+    long page_sz = sysconf(_SC_PAGE_SIZE);
+    long pages = mem_size / page_sz;
+    printf("Target memsize is %3.2f GBs\n", (double)mem_size/(1024*1024*1024));
+    fflush(stdout);
+    char* p = (char*) mmap(NULL, mem_size, PROT_READ | PROT_WRITE,
+                    MAP_NORESERVE|MAP_PRIVATE|MAP_ANONYMOUS, -1, (off_t) 0);
+    if (p == MAP_FAILED) {
+        perror("Failed anon MMAP competition");
+        return EXIT_FAILURE;
+    }
+
+    // fault the whole region in so pressure starts at the target RSS.
+    double t0 = now_seconds();
+    for (long i = 0; i < pages && !stopped; i++) {
+        p[i * page_sz] = 1;
+    }
+    printf("Resident: %.1f MiB after %.2f s\n", resident_bytes() / (1024.0 * 1024.0), now_seconds() - t0);
+    fflush(stdout);
+
+    if (opt_ready_file != nullptr) {
+        // block SIGUSR1 until sigsuspend so a start sent right after the
+        // ready file appears is not lost.
+        sigset_t block;
+        sigemptyset(&block);
+        sigaddset(&block, SIGUSR1);
+        sigprocmask(SIG_BLOCK, &block, nullptr);
+        FILE* file = fopen(opt_ready_file, "w");
+        if (file == nullptr) {
+            perror("Error in system call fopen");
+            munmap(p, mem_size);
+            return EXIT_FAILURE;
+        }
+        fprintf(file, "%d\n", (int) getpid());
+        fclose(file);
+        printf("Ready, waiting for SIGUSR1.\n");
+        fflush(stdout);
+        sigset_t empty;
+        sigemptyset(&empty);
+        while (!started && !stopped) {
+            sigsuspend(&empty);
+        }
+        sigprocmask(SIG_UNBLOCK, &block, nullptr);
+    }
+
+    Xoshiro256ss rng((uint64_t) getpid());
+    bool random = strcmp(opt_pattern, "random") == 0;
+    uint64_t write_step = (uint64_t) (opt_write_fraction * WRITE_ONE);
+    uint64_t write_acc = 0;
+    uint64_t touches = 0;
+    long next = 0;
+    char sink = 0;
+
+    pressure_sample begin = take_sample(0);
+    pressure_sample last = begin;
+    double deadline = opt_duration > 0 ? begin.time + opt_duration : 0;
+    printf("Applying pressure.\n");
+    fflush(stdout);
+    while (!stopped) {
+        for (int b = 0; b < TOUCH_BATCH; b++) {
+            long page;
+            if (random) {
+                page = (long) rng.below(pages);
+            } else {
+                page = next;
+                next = next + 1 < pages ? next + 1 : 0;
+            }
+            volatile char* a = p + page * page_sz;
+            // one read per touch, and a write for opt_write_fraction of them.
+            sink += *a;
+            write_acc += write_step;
+            if (write_acc >= WRITE_ONE) {
+                write_acc -= WRITE_ONE;
+                *a = 1;
+            }
+        }
+        touches += TOUCH_BATCH;
+
+        double now = now_seconds();
+        if (deadline > 0 && now >= deadline) {
+            break;
+        }
+        // pace against the start time so sleeping overshoot does not drift.
+        if (opt_rate > 0) {
+            double due = begin.time + touches / opt_rate;
+            if (due > now) {
+                struct timespec ts;
+                double wait = due - now;
+                ts.tv_sec = (time_t) wait;
+                ts.tv_nsec = (long) ((wait - ts.tv_sec) * 1e9);
+                nanosleep(&ts, nullptr);
+            }
+        }
+        if (opt_report_interval > 0 && now - last.time >= opt_report_interval) {
+            pressure_sample s = take_sample(touches);
+            report("Interval", last, s);
+            last = s;
+        }
+    }
+    report("Overall", begin, take_sample(touches));
+    printf("Touched %llu pages (%d)\n", (unsigned long long) touches, sink & 1);
+
+    munmap(p, mem_size);
+    if (opt_ready_file != nullptr) {
+        unlink(opt_ready_file);
+    }
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv) {
+    if (!parse_options(argc, argv)) {
         return EXIT_FAILURE;
     }
 
-    // unused pointer
-    void* unused = NULL;
-    compete_for_memory(unused);
-}
\ No newline at end of file
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_start;
+    sigaction(SIGUSR1, &sa, nullptr);
+    sa.sa_handler = on_stop;
+    sigaction(SIGUSR2, &sa, nullptr);
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    if (opt_cpu == -2) {
+        Topology topo;
+        opt_cpu = topo.helper_cpu(topo.measure_cpu());
+        if (opt_cpu >= 0) {
+            printf("Pinning to cpu %d (from topology).\n", opt_cpu);
+        } else {
+            printf("No cpu besides the measured one, not pinning.\n");
+        }
+    }
+    if (opt_cpu >= 0) {
+        int cpu_id = opt_cpu;
+        pid_t pid = 0;
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        CPU_SET(cpu_id, &mask);
+        size_t cpusetsize = sizeof(mask);
+        if(sched_setaffinity(pid, cpusetsize, &mask) == -1) {
+            perror("Oh no. CPU Set Operation Failed.");
+            return EXIT_FAILURE;
+        }
+    }
+
+    // every page gets written, so a size past what is available ends in
+    // swap or the OOM killer rather than in pressure.
+    long available = get_mem_available();
+    long mem_size = opt_rss > 0 ? opt_rss : available / 2;
+    if (mem_size > available && !opt_force) {
+        printf("--rss %.2f GiB is above MemAvailable (%.2f GiB); pass --force to run anyway.\n",
+               mem_size / (1024.0 * 1024 * 1024), available / (1024.0 * 1024 * 1024));
+        return EXIT_FAILURE;
+    }
+    if (mem_size < sysconf(_SC_PAGE_SIZE)) {
+        printf("No memory available to compete for.\n");
+        return EXIT_FAILURE;
+    }
+    return compete_for_memory(mem_size);
+}
@@ -0,0 +1,226 @@
+#ifndef CONTENTION_H
+#define CONTENTION_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <cstdint> // for uint64_t
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mem_access.h"
+
+// cross-core coherence cost of counter layouts. every thread adds 1 to "its"
+// counter ops times; only where the counters live changes:
+//   shared      one atomic every thread adds to (true sharing)
+//   same_line   one atomic per thread, packed 8 bytes apart, so up to 8
+//               threads fight over each line (false sharing)
+//   padded64    one atomic per thread on its own 64 B line
+//   padded128   one per 128 B, clear of the adjacent-line prefetcher too
+//   sharded     a plain per-thread counter (128 B apart), folded into one
+//               shared atomic every merge_interval ops
+enum contention_layout {
+    CONTENTION_SHARED, CONTENTION_SAME_LINE, CONTENTION_PADDED64, CONTENTION_PADDED128,
+    CONTENTION_SHARDED, CONTENTION_NUM_LAYOUTS
+};
+
+static const char* const CONTENTION_LAYOUT_NAMES[CONTENTION_NUM_LAYOUTS] = {
+    "shared", "same_line", "padded64", "padded128", "sharded"
+};
+
+// generic events only; snoop / HITM events are model specific, but the LLC
+// and cache reference counts move with the coherence traffic.
+static const struct perf_event_spec CONTENTION_EVENTS[] = {
+    {"Cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, true},
+    {"Cache References", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES, true},
+    {"Cache Misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, true},
+    {"LLC Read Accesses", PERF_TYPE_HW_CACHE,
+     hw_cache_config(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_ACCESS), true},
+    {"LLC Read Misses", PERF_TYPE_HW_CACHE,
+     hw_cache_config(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS), true},
+    {"LLC Write Misses", PERF_TYPE_HW_CACHE,
+     hw_cache_config(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_WRITE, PERF_COUNT_HW_CACHE_RESULT_MISS), true},
+};
+
+static const size_t NUM_CONTENTION_EVENTS = sizeof(CONTENTION_EVENTS) / sizeof(CONTENTION_EVENTS[0]);
+
+template <size_t ALIGN>
+struct counter_slot {
+    alignas(ALIGN) std::atomic<uint64_t> value;
+};
+
+// a sharded thread's private count, padded so neighbours never share.
+struct alignas(128) shard_slot {
+    uint64_t value;
+};
+
+// ops increments of slot, relaxed: the coherence traffic is the point.
+__attribute__((noinline))
+static void add_atomic(std::atomic<uint64_t>& slot, long ops) {
+    for (long i = 0; i < ops; i++) {
+        slot.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+__attribute__((noinline))
+static void add_sharded(shard_slot& local, std::atomic<uint64_t>& total, long ops, long merge_interval) {
+    // volatile so every op is a real load and store, as a per-thread stats
+    // slot would see, rather than a register the compiler folds away.
+    volatile uint64_t& count = local.value;
+    for (long i = 0; i < ops; i++) {
+        count = count + 1;
+        if (count == (uint64_t) merge_interval) {
+            total.fetch_add(count, std::memory_order_relaxed);
+            count = 0;
+        }
+    }
+    total.fetch_add(count, std::memory_order_relaxed);
+    count = 0;
+}
+
+struct contention_result {
+    double seconds;                             // slowest thread
+    uint64_t total;                             // sum of every counter afterwards
+    bool counters_ok;
+    std::map<std::string, uint64_t> values;     // summed over threads
+};
+
+// one run: nthreads threads pinned to cpus[t % size], released together
+// once their counters are open, each counting only itself. events are the
+// ones known to open (see contention_sweep).
+static inline contention_result run_contention(contention_layout layout, int nthreads,
+                                               const std::vector<int>& cpus, long ops, long merge_interval,
+                                               const std::vector<perf_event_spec>& events) {
+    std::vector<counter_slot<8> > packed(nthreads);
+    std::vector<counter_slot<64> > padded64(nthreads);
+    std::vector<counter_slot<128> > padded128(nthreads);
+    std::vector<shard_slot> shards(nthreads);
+    counter_slot<128> shared;
+    shared.value = 0;
+    for (int t = 0; t < nthreads; t++) {
+        packed[t].value = 0;
+        padded64[t].value = 0;
+        padded128[t].value = 0;
+        shards[t].value = 0;
+    }
+
+    std::vector<thread_result> results(nthreads);
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nthreads; t++) {
+        threads.push_back(std::thread([&, t]() {
+            thread_result& res = results[t];
+            res.cpu = cpus[t % cpus.size()];
+            if (pin_to_cpu(res.cpu) == -1) {
+                perror("Oh no. CPU Set Operation Failed.");
+            }
+            PerfCounterSet counters;
+            counters.add(events.data(), events.size());
+            res.counters_ok = !events.empty() && counters.open();
+
+            ready++;
+            while (!go.load(std::memory_order_acquire)) {
+            }
+
+            counters.reset();
+            counters.enable();
+            double start = now_seconds();
+            switch (layout) {
+                case CONTENTION_SHARED: add_atomic(shared.value, ops); break;
+                case CONTENTION_SAME_LINE: add_atomic(packed[t].value, ops); break;
+                case CONTENTION_PADDED64: add_atomic(padded64[t].value, ops); break;
+                case CONTENTION_PADDED128: add_atomic(padded128[t].value, ops); break;
+                default: add_sharded(shards[t], shared.value, ops, merge_interval); break;
+            }
+            res.seconds = now_seconds() - start;
+            counters.disable();
+            if (res.counters_ok) {
+                res.values = counters.read();
+            }
+        }));
+    }
+    while (ready.load() < nthreads) {
+    }
+    go.store(true, std::memory_order_release);
+    for (size_t t = 0; t < threads.size(); t++) {
+        threads[t].join();
+    }
+
+    contention_result out;
+    out.seconds = 0;
+    out.total = shared.value.load();
+    out.counters_ok = true;
+    for (int t = 0; t < nthreads; t++) {
+        out.total += packed[t].value.load() + padded64[t].value.load() + padded128[t].value.load();
+        if (results[t].seconds > out.seconds) {
+            out.seconds = results[t].seconds;
+        }
+        out.counters_ok &= results[t].counters_ok;
+        for (std::map<std::string, uint64_t>::const_iterator it = results[t].values.begin();
+             it != results[t].values.end(); ++it) {
+            out.values[it->first] += it->second;
+        }
+    }
+    return out;
+}
+
+// every layout at 1, 2, 4, ... threads up to cpus.size() (and at exactly
+// cpus.size()). prints aggregate Mops/s, ns per op per thread, and the
+// counters per op; the total is checked so a lost update would show.
+static inline int contention_sweep(const std::vector<int>& cpus, long ops, long merge_interval) {
+    if (cpus.empty()) {
+        printf("No CPUs available for the contention sweep.\n");
+        return EXIT_FAILURE;
+    }
+    // find out once which events this PMU has, instead of every thread of
+    // every run reporting the same skips.
+    std::vector<perf_event_spec> events;
+    {
+        PerfCounterSet probe;
+        probe.add(CONTENTION_EVENTS, NUM_CONTENTION_EVENTS);
+        probe.open();
+        for (size_t i = 0; i < NUM_CONTENTION_EVENTS; i++) {
+            for (size_t n = 0; n < probe.names().size(); n++) {
+                if (probe.names()[n] == CONTENTION_EVENTS[i].name) {
+                    events.push_back(CONTENTION_EVENTS[i]);
+                }
+            }
+        }
+    }
+    std::vector<int> counts;
+    for (size_t n = 1; n < cpus.size(); n *= 2) {
+        counts.push_back((int) n);
+    }
+    counts.push_back((int) cpus.size());
+
+    printf("Contention Sweep, %ld ops per thread, sharded merge every %ld ops, 1..%zu threads\n", ops,
+           merge_interval, cpus.size());
+    printf("%-10s %7s %10s %10s %11s %11s %11s %11s %6s\n", "Layout", "Threads", "Mops/s", "ns/op",
+           "Cycles/op", "CacheRef/op", "CacheMis/op", "LLC Mis/op", "Total");
+    for (size_t c = 0; c < counts.size(); c++) {
+        int n = counts[c];
+        for (int l = 0; l < CONTENTION_NUM_LAYOUTS; l++) {
+            contention_result r = run_contention((contention_layout) l, n, cpus, ops, merge_interval, events);
+            double all_ops = (double) ops * n;
+            const std::map<std::string, uint64_t>& v = r.values;
+            printf("%-10s %7d %10.1f %10.2f", CONTENTION_LAYOUT_NAMES[l], n, all_ops / r.seconds / 1e6,
+                   r.seconds * 1e9 / ops);
+            if (r.counters_ok) {
+                printf(" %11.2f %11.4f %11.4f %11.4f", counter_value(v, "Cycles") / all_ops,
+                       counter_value(v, "Cache References") / all_ops, counter_value(v, "Cache Misses") / all_ops,
+                       (counter_value(v, "LLC Read Misses") + counter_value(v, "LLC Write Misses")) / all_ops);
+            } else {
+                printf(" %11s %11s %11s %11s", "-", "-", "-", "-");
+            }
+            printf(" %6s\n", r.total == (uint64_t) all_ops ? "ok" : "LOST");
+            fflush(stdout);
+        }
+        printf("------------------------\n");
+    }
+    return EXIT_SUCCESS;
+}
+
+#endif // CONTENTION_H
@@ -0,0 +1,159 @@
+#ifndef CORE_LATENCY_H
+#define CORE_LATENCY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <algorithm> // for std::sort
+#include <cstdint> // for uint64_t
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mem_access.h" // for pin_to_cpu, now_seconds
+#include "topology.h"
+#include "trial_stats.h" // for percentile
+
+// untimed round trips before each pair is measured.
+#define CORE_LATENCY_WARMUP 200
+// a new cluster starts where sorted latencies jump by more than this factor.
+#define CORE_LATENCY_CLUSTER_GAP 1.25
+
+// round trip of one cache line between cpus a and b: a CASes the line from
+// 2i to 2i + 1, b waits for that and CASes it on to 2i + 2, and so on. each
+// step needs the line moved to the other core, so rounds / time is two
+// handoffs. samples timed runs of rounds each; the median is returned, in ns.
+static inline double cas_round_trip_ns(int a, int b, long rounds, int samples) {
+    struct alignas(128) line {
+        std::atomic<uint64_t> value;
+    };
+    line flag;
+    flag.value.store(0);
+    long total = CORE_LATENCY_WARMUP + rounds * samples;
+    std::vector<double> ns;
+    std::atomic<int> ready(0);
+
+    std::thread responder([&]() {
+        pin_to_cpu(b);
+        ready++;
+        for (long i = 0; i < total; i++) {
+            uint64_t expected = 2 * i + 1;
+            while (!flag.value.compare_exchange_weak(expected, 2 * i + 2, std::memory_order_acq_rel)) {
+                expected = 2 * i + 1;
+            }
+        }
+    });
+    std::thread initiator([&]() {
+        pin_to_cpu(a);
+        ready++;
+        while (ready.load() < 2) {
+        }
+        double start = 0;
+        for (long i = 0; i < total; i++) {
+            long timed = i - CORE_LATENCY_WARMUP;
+            if (timed >= 0 && timed % rounds == 0) {
+                if (timed > 0) {
+                    ns.push_back((now_seconds() - start) * 1e9 / rounds);
+                }
+                start = now_seconds();
+            }
+            uint64_t expected = 2 * i;
+            while (!flag.value.compare_exchange_weak(expected, 2 * i + 1, std::memory_order_acq_rel)) {
+                expected = 2 * i;
+            }
+        }
+        // the last round is done once b has answered it.
+        while (flag.value.load(std::memory_order_acquire) != 2 * (uint64_t) total) {
+        }
+        ns.push_back((now_seconds() - start) * 1e9 / rounds);
+    });
+    initiator.join();
+    responder.join();
+    std::sort(ns.begin(), ns.end());
+    return percentile(ns, 0.5);
+}
+
+// every ordered pair of cpus, printed as an NxN matrix of round trip ns
+// (row initiates, column responds), then the pairs grouped into latency
+// clusters, each labelled with the topology relations of its members so
+// e.g. "smt sibling", "same llc" and "cross package" line up with the tiers.
+static inline int core_latency_matrix(const std::vector<int>& cpus, const Topology& topo, long rounds, int samples) {
+    size_t n = cpus.size();
+    if (n < 2) {
+        printf("Core latency needs at least two cpus.\n");
+        return EXIT_FAILURE;
+    }
+    printf("Core to Core CAS Round Trip (ns), %ld rounds x %d samples per pair, median\n", rounds, samples);
+    std::vector<std::vector<double> > rt(n, std::vector<double>(n, 0));
+    printf("%6s", "");
+    for (size_t j = 0; j < n; j++) {
+        printf(" %6d", cpus[j]);
+    }
+    printf("\n");
+    for (size_t i = 0; i < n; i++) {
+        printf("%6d", cpus[i]);
+        for (size_t j = 0; j < n; j++) {
+            if (cpus[i] == cpus[j]) {
+                printf(" %6s", "-");
+                continue;
+            }
+            rt[i][j] = cas_round_trip_ns(cpus[i], cpus[j], rounds, samples);
+            printf(" %6.0f", rt[i][j]);
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+    printf("------------------------\n");
+
+    // one latency per unordered pair: the mean of both directions.
+    struct pair_latency {
+        double ns;
+        int a;
+        int b;
+    };
+    std::vector<pair_latency> pairs;
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = i + 1; j < n; j++) {
+            if (cpus[i] != cpus[j]) {
+                pair_latency p = { (rt[i][j] + rt[j][i]) / 2, cpus[i], cpus[j] };
+                pairs.push_back(p);
+            }
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(),
+              [](const pair_latency& x, const pair_latency& y) { return x.ns < y.ns; });
+
+    printf("Latency Clusters (a new cluster at a %.0f%% jump)\n", (CORE_LATENCY_CLUSTER_GAP - 1) * 100);
+    printf("%7s %10s %10s %7s  %s\n", "Cluster", "Min ns", "Max ns", "Pairs", "Relations");
+    size_t start = 0;
+    int cluster = 0;
+    for (size_t k = 1; k <= pairs.size(); k++) {
+        if (k < pairs.size() && pairs[k].ns <= pairs[k - 1].ns * CORE_LATENCY_CLUSTER_GAP) {
+            continue;
+        }
+        std::map<std::string, int> relations;
+        for (size_t m = start; m < k; m++) {
+            relations[topo.relation(pairs[m].a, pairs[m].b)]++;
+        }
+        std::string label;
+        for (std::map<std::string, int>::const_iterator it = relations.begin(); it != relations.end(); ++it) {
+            label += (label.empty() ? "" : ", ") + it->first + " x" + std::to_string(it->second);
+        }
+        printf("%7d %10.0f %10.0f %7zu  %s\n", cluster, pairs[start].ns, pairs[k - 1].ns, k - start,
+               label.c_str());
+        if (k - start <= 8) {
+            printf("%7s", "");
+            for (size_t m = start; m < k; m++) {
+                printf(" %d-%d", pairs[m].a, pairs[m].b);
+            }
+            printf("\n");
+        }
+        cluster++;
+        start = k;
+    }
+    printf("------------------------\n");
+    return EXIT_SUCCESS;
+}
+
+#endif // CORE_LATENCY_H
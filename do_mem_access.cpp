@@ -0,0 +1,864 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sched.h> // for cpu_set_t and other scheduling things.
+#include <getopt.h> // for getopt_long
+#include <cstring> // for memset
+#include <cstdint> // for uint64_t
+#include <cinttypes> // for PRIu64
+#include <sys/resource.h>
+#include <sys/types.h> // for pid_t
+#include <string>
+#include <vector>
+
+#include "mem_access.h"
+#include "region.h"
+#include "topology.h"
+#include "cache_flush.h"
+#include "pointer_chase.h"
+#include "page_fault_profile.h"
+#include "file_hints.h"
+#include "io_engines.h"
+#include "mem_sampler.h"
+#include "timeseries.h"
+#include "stream_bandwidth.h"
+#include "contention.h"
+#include "core_latency.h"
+#include "small_objects.h"
+#include "trace.h"
+#include "trial_stats.h"
+#include "results_writer.h"
+
+
+// global vars for what to run on: region type (see REGION_TYPES), its size
+// in bytes, and the cpus. trials pin to the first cpu, the thread and
+// bandwidth sweeps use all of them. with none given the topology picks:
+// a core away from cpu 0 for trials, every allowed cpu (one thread per
+// core first) for the sweeps.
+const char* opt_region = "mmap_private_file_backed_memset";
+size_t opt_size = 1024 * 1024 * 1024;
+std::vector<int> opt_cpus;
+
+// global var for the counters opened in trial mode (all of MEM_ACCESS_EVENTS
+// when empty).
+std::vector<perf_event_spec> opt_events;
+
+// global vars to pick the access pattern (sequential, random, strided,
+// zipfian, gaussian, mixed) and its window / locality / write knobs.
+const char* opt_access_pattern = "random";
+access_params opt_access = DEFAULT_ACCESS_PARAMS;
+
+// global vars for the window size: unless --window-lines is given, a window
+// is the data capacity of cache level opt_window_cache on the measured cpu.
+int opt_window_cache = 1;
+int opt_window_lines_given = 0;
+
+// global var to measure one counter group per trial (round robin) instead of
+// letting the kernel multiplex all of them in every trial.
+int opt_rotate_groups = 0;
+
+// global vars for the scaling mode: sweep 1..N pinned threads instead of the
+// single-cpu trials, each walking a private slice or the shared region.
+int opt_thread_sweep = 0;
+int opt_shared_region = 0;
+
+// global var to run the dependent-load latency sweep instead of the trials.
+int opt_pointer_chase = 0;
+
+// global var to profile first-touch page fault cost instead of the trials,
+// for every region type unless --region is given.
+int opt_fault_profile = 0;
+int opt_region_given = 0;
+
+// global var to run the cold-cache madvise/populate/readahead matrix on a
+// real data file (sequential and random, plus --pattern) instead of the trials.
+int opt_file_hints = 0;
+
+// global vars for the file read engine comparison (mmap, pread, preadv,
+// O_DIRECT, io_uring) on the same data file and patterns as --file-hints.
+int opt_io_engines = 0;
+size_t opt_io_block = 4096;
+int opt_io_depth = 32;
+int opt_io_warm = 0;
+
+// global vars for address sampling: one walk with a sampled memory event,
+// folded into per-page and per-line heatmaps written to <prefix>_pages.csv
+// and <prefix>_lines.csv.
+int opt_sample_memory = 0;
+uint64_t opt_sample_period = 10007;
+const char* opt_heatmap_prefix = "heatmap";
+
+// global vars for the time series: with a path set, a sampler thread on
+// another cpu reads the counters, RSS and fault counts every interval of
+// each measured trial and the rates are written there (in --format).
+const char* opt_timeseries_path = nullptr;
+double opt_timeseries_interval_ms = 10;
+
+// global vars for the flush before each trial: the eviction buffer is
+// opt_flush_multiple times the last level cache. clflush also flushes the
+// target region line by line, remap moves an mmap'd region to a fresh
+// address so the TLB starts cold.
+int opt_flush_multiple = 4;
+int opt_flush_clflush = 0;
+int opt_flush_remap = 0;
+
+// global var to run the copy/scale/add/triad bandwidth suite instead of the trials.
+int opt_stream_bandwidth = 0;
+
+// global vars for the contention suite: counter layouts (shared, same line,
+// padded, sharded) hammered by 1..N threads, ops increments each, sharded
+// counters merged every opt_merge_interval ops.
+int opt_contention = 0;
+long opt_contention_ops = 1 << 22;
+long opt_merge_interval = 1024;
+
+// global vars for the core to core latency matrix: every cpu pair bounces a
+// line with CAS, opt_latency_samples runs of opt_latency_rounds round trips.
+int opt_core_latency = 0;
+long opt_latency_rounds = 5000;
+int opt_latency_samples = 5;
+
+// small object mode: --size worth of opt_object_size byte objects from each
+// allocator in allocators.h (or only opt_allocator), walked --locality times.
+size_t opt_object_size = 0;
+const char* opt_allocator = nullptr;
+
+// global vars for address traces: record writes trial 0's window starts to
+// a trace file, replay drives every trial from a trace instead of a pattern.
+const char* opt_record_trace = nullptr;
+const char* opt_replay_trace = nullptr;
+
+// global vars for the trial harness. warmup trials run but are discarded,
+// then opt_trials are measured. with opt_target_ci set, measuring goes on
+// (up to opt_max_trials) until the bootstrap CI of the median of
+// opt_ci_metric is narrower than that fraction of the median.
+int opt_warmup_trials = 1;
+int opt_trials = 5;
+int opt_max_trials = 50;
+double opt_target_ci = 0;
+const char* opt_ci_metric = "Access Time (s)";
+
+// global vars for the per-trial results file: one record per trial (warmup
+// included, flagged) with the run metadata, "csv" or "json" (one object per line).
+const char* opt_results_path = "metrics.csv";
+const char* opt_results_format = "csv";
+
+static void usage(const char* argv0) {
+    printf("usage: %s [options]\n", argv0);
+    printf("  --region TYPE          region type (default %s):\n                        ", opt_region);
+    for (size_t i = 0; i < NUM_REGION_TYPES; i++) {
+        printf(" %s", REGION_TYPES[i].name);
+    }
+    printf("\n");
+    printf("  --size BYTES           region size, K/M/G suffixes allowed (default 1G)\n");
+    printf("  --cpus LIST            cpus, e.g. 4 or 0-3,8 (default from topology, sweeps: all)\n");
+    printf("  --events LIST          comma separated counter names (default all):\n");
+    for (size_t i = 0; i < NUM_MEM_ACCESS_EVENTS; i++) {
+        printf("                         %s\n", MEM_ACCESS_EVENTS[i].name);
+    }
+    printf("  --pattern NAME         access pattern:");
+    for (size_t i = 0; i < NUM_ACCESS_PATTERNS; i++) {
+        printf(" %s", ACCESS_PATTERN_NAMES[i]);
+    }
+    printf(" (default %s)\n", opt_access_pattern);
+    printf("  --iterations N  --window-lines N  --locality N  --write-fraction F\n");
+    printf("  --line-stride N  --stride-lines N  --zipf-theta F  --hot-center F\n");
+    printf("  --hot-width F  --phase-iterations N  --no-precompute\n");
+    printf("                         walk knobs (see access_params)\n");
+    printf("  --window-cache LEVEL   size windows to this cache level, 0 = LLC (default 1,\n");
+    printf("                         ignored with --window-lines)\n");
+    printf("  --trials N  --warmup N  --max-trials N  --target-ci F  --ci-metric NAME\n");
+    printf("                         trial harness (default 5 trials, 1 warmup)\n");
+    printf("  --rotate-groups        one counter group per trial instead of multiplexing\n");
+    printf("  --flush-multiple N  --flush-clflush  --flush-remap\n");
+    printf("                         pre-trial flush: N x LLC eviction buffer (default 4),\n");
+    printf("                         clflush the region, move it to a cold address\n");
+    printf("  --thread-sweep [--shared]  scaling sweep over 1..N pinned threads\n");
+    printf("  --pointer-chase        dependent load latency sweep\n");
+    printf("  --fault-profile        per-page first-touch fault cost per region type\n");
+    printf("  --file-hints           cold-cache mmap reads under each access hint\n");
+    printf("  --io-engines [--io-block BYTES] [--io-depth N] [--io-warm]\n");
+    printf("                         mmap/pread/preadv/O_DIRECT/io_uring reads (default 4K, depth 32, cold)\n");
+    printf("  --stream               copy/scale/add/triad bandwidth suite\n");
+    printf("  --contention [--contention-ops N] [--merge-interval N]\n");
+    printf("                         false sharing / padding / sharding sweep over 1..N threads\n");
+    printf("  --core-latency [--latency-rounds N] [--latency-samples N]\n");
+    printf("                         CAS round trip matrix over --cpus (default all) and its clusters\n");
+    printf("  --objects BYTES [--allocator NAME]\n");
+    printf("                         --size of small objects per allocator (malloc arena slab\n");
+    printf("                         pmr_monotonic pmr_pool, default all): alloc/free/walk cost\n");
+    printf("  --sample-memory [--sample-period N] [--heatmap PREFIX]\n");
+    printf("                         sampled load addresses -> page/line heatmaps (default 10007, heatmap)\n");
+    printf("  --record-trace FILE  --replay-trace FILE\n");
+    printf("  --results FILE  --format csv|json   per-trial records (default metrics.csv)\n");
+    printf("  --timeseries FILE [--timeseries-interval MS]\n");
+    printf("                         counter/RSS/fault rates every interval of each trial (default 10 ms)\n");
+}
+
+// "64K", "256M", "1G" or plain bytes. 0 on a malformed size.
+static size_t parse_size(const char* s) {
+    char* end;
+    unsigned long long v = strtoull(s, &end, 0);
+    switch (*end) {
+        case 'k': case 'K': v <<= 10; end++; break;
+        case 'm': case 'M': v <<= 20; end++; break;
+        case 'g': case 'G': v <<= 30; end++; break;
+        default: break;
+    }
+    if (*end == 'i' || *end == 'B') {
+        end++;
+    }
+    return *end == '\0' ? (size_t) v : 0;
+}
+
+// comma separated MEM_ACCESS_EVENTS names, or "all".
+static bool parse_event_list(const char* s, std::vector<perf_event_spec>& events) {
+    events.clear();
+    if (strcmp(s, "all") == 0) {
+        return true;
+    }
+    std::string list(s);
+    size_t pos = 0;
+    while (pos <= list.size()) {
+        size_t comma = list.find(',', pos);
+        if (comma == std::string::npos) {
+            comma = list.size();
+        }
+        std::string name = list.substr(pos, comma - pos);
+        const perf_event_spec* spec = find_mem_access_event(name.c_str());
+        if (spec == nullptr) {
+            printf("Unknown event: %s\n", name.c_str());
+            return false;
+        }
+        events.push_back(*spec);
+        pos = comma + 1;
+    }
+    return true;
+}
+
+// fill the opt_ globals from the command line. false means exit.
+static bool parse_options(int argc, char** argv) {
+    enum {
+        OPT_REGION = 256, OPT_SIZE, OPT_CPUS, OPT_EVENTS, OPT_PATTERN, OPT_ITERATIONS,
+        OPT_WINDOW_LINES, OPT_WINDOW_CACHE, OPT_LOCALITY, OPT_WRITE_FRACTION, OPT_LINE_STRIDE, OPT_STRIDE_LINES,
+        OPT_ZIPF_THETA, OPT_HOT_CENTER, OPT_HOT_WIDTH, OPT_PHASE_ITERATIONS, OPT_NO_PRECOMPUTE,
+        OPT_TRIALS, OPT_WARMUP, OPT_MAX_TRIALS, OPT_TARGET_CI, OPT_CI_METRIC, OPT_ROTATE_GROUPS,
+        OPT_THREAD_SWEEP, OPT_SHARED, OPT_POINTER_CHASE, OPT_FAULT_PROFILE, OPT_FILE_HINTS, OPT_IO_ENGINES, OPT_IO_BLOCK, OPT_IO_DEPTH,
+        OPT_IO_WARM, OPT_SAMPLE_MEMORY, OPT_SAMPLE_PERIOD, OPT_HEATMAP, OPT_STREAM, OPT_RECORD_TRACE,
+        OPT_REPLAY_TRACE, OPT_RESULTS, OPT_FORMAT, OPT_TIMESERIES, OPT_TIMESERIES_INTERVAL, OPT_FLUSH_MULTIPLE,
+        OPT_FLUSH_CLFLUSH, OPT_FLUSH_REMAP, OPT_CONTENTION, OPT_CONTENTION_OPS,
+        OPT_MERGE_INTERVAL, OPT_CORE_LATENCY, OPT_LATENCY_ROUNDS, OPT_LATENCY_SAMPLES, OPT_OBJECTS,
+        OPT_ALLOCATOR, OPT_HELP,
+    };
+    static const struct option options[] = {
+        {"region", required_argument, nullptr, OPT_REGION},
+        {"size", required_argument, nullptr, OPT_SIZE},
+        {"cpus", required_argument, nullptr, OPT_CPUS},
+        {"events", required_argument, nullptr, OPT_EVENTS},
+        {"pattern", required_argument, nullptr, OPT_PATTERN},
+        {"iterations", required_argument, nullptr, OPT_ITERATIONS},
+        {"window-lines", required_argument, nullptr, OPT_WINDOW_LINES},
+        {"window-cache", required_argument, nullptr, OPT_WINDOW_CACHE},
+        {"locality", required_argument, nullptr, OPT_LOCALITY},
+        {"write-fraction", required_argument, nullptr, OPT_WRITE_FRACTION},
+        {"line-stride", required_argument, nullptr, OPT_LINE_STRIDE},
+        {"stride-lines", required_argument, nullptr, OPT_STRIDE_LINES},
+        {"zipf-theta", required_argument, nullptr, OPT_ZIPF_THETA},
+        {"hot-center", required_argument, nullptr, OPT_HOT_CENTER},
+        {"hot-width", required_argument, nullptr, OPT_HOT_WIDTH},
+        {"phase-iterations", required_argument, nullptr, OPT_PHASE_ITERATIONS},
+        {"no-precompute", no_argument, nullptr, OPT_NO_PRECOMPUTE},
+        {"trials", required_argument, nullptr, OPT_TRIALS},
+        {"warmup", required_argument, nullptr, OPT_WARMUP},
+        {"max-trials", required_argument, nullptr, OPT_MAX_TRIALS},
+        {"target-ci", required_argument, nullptr, OPT_TARGET_CI},
+        {"ci-metric", required_argument, nullptr, OPT_CI_METRIC},
+        {"rotate-groups", no_argument, nullptr, OPT_ROTATE_GROUPS},
+        {"thread-sweep", no_argument, nullptr, OPT_THREAD_SWEEP},
+        {"shared", no_argument, nullptr, OPT_SHARED},
+        {"pointer-chase", no_argument, nullptr, OPT_POINTER_CHASE},
+        {"fault-profile", no_argument, nullptr, OPT_FAULT_PROFILE},
+        {"file-hints", no_argument, nullptr, OPT_FILE_HINTS},
+        {"io-engines", no_argument, nullptr, OPT_IO_ENGINES},
+        {"io-block", required_argument, nullptr, OPT_IO_BLOCK},
+        {"io-depth", required_argument, nullptr, OPT_IO_DEPTH},
+        {"io-warm", no_argument, nullptr, OPT_IO_WARM},
+        {"sample-memory", no_argument, nullptr, OPT_SAMPLE_MEMORY},
+        {"sample-period", required_argument, nullptr, OPT_SAMPLE_PERIOD},
+        {"heatmap", required_argument, nullptr, OPT_HEATMAP},
+        {"stream", no_argument, nullptr, OPT_STREAM},
+        {"record-trace", required_argument, nullptr, OPT_RECORD_TRACE},
+        {"replay-trace", required_argument, nullptr, OPT_REPLAY_TRACE},
+        {"results", required_argument, nullptr, OPT_RESULTS},
+        {"format", required_argument, nullptr, OPT_FORMAT},
+        {"timeseries", required_argument, nullptr, OPT_TIMESERIES},
+        {"timeseries-interval", required_argument, nullptr, OPT_TIMESERIES_INTERVAL},
+        {"flush-multiple", required_argument, nullptr, OPT_FLUSH_MULTIPLE},
+        {"flush-clflush", no_argument, nullptr, OPT_FLUSH_CLFLUSH},
+        {"flush-remap", no_argument, nullptr, OPT_FLUSH_REMAP},
+        {"contention", no_argument, nullptr, OPT_CONTENTION},
+        {"contention-ops", required_argument, nullptr, OPT_CONTENTION_OPS},
+        {"merge-interval", required_argument, nullptr, OPT_MERGE_INTERVAL},
+        {"core-latency", no_argument, nullptr, OPT_CORE_LATENCY},
+        {"latency-rounds", required_argument, nullptr, OPT_LATENCY_ROUNDS},
+        {"latency-samples", required_argument, nullptr, OPT_LATENCY_SAMPLES},
+        {"objects", required_argument, nullptr, OPT_OBJECTS},
+        {"allocator", required_argument, nullptr, OPT_ALLOCATOR},
+        {"help", no_argument, nullptr, OPT_HELP},
+        {nullptr, 0, nullptr, 0},
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "", options, nullptr)) != -1) {
+        switch (c) {
+            case OPT_REGION:
+                opt_region = optarg;
+                opt_region_given = 1;
+                break;
+            case OPT_SIZE:
+                opt_size = parse_size(optarg);
+                if (opt_size == 0) {
+                    printf("Bad size: %s\n", optarg);
+                    return false;
+                }
+                break;
+            case OPT_CPUS:
+                if (!parse_cpu_list(optarg, opt_cpus)) {
+                    printf("Bad cpu list: %s\n", optarg);
+                    return false;
+                }
+                break;
+            case OPT_EVENTS:
+                if (!parse_event_list(optarg, opt_events)) {
+                    return false;
+                }
+                break;
+            case OPT_PATTERN: opt_access_pattern = optarg; break;
+            case OPT_ITERATIONS: opt_access.iterations = atol(optarg); break;
+            case OPT_WINDOW_LINES:
+                opt_access.window_lines = atoi(optarg);
+                opt_window_lines_given = 1;
+                break;
+            case OPT_WINDOW_CACHE: opt_window_cache = atoi(optarg); break;
+            case OPT_LOCALITY: opt_access.locality = atoi(optarg); break;
+            case OPT_WRITE_FRACTION: opt_access.write_fraction = atof(optarg); break;
+            case OPT_LINE_STRIDE: opt_access.line_stride = atoi(optarg); break;
+            case OPT_STRIDE_LINES: opt_access.stride_lines = atol(optarg); break;
+            case OPT_ZIPF_THETA: opt_access.zipf_theta = atof(optarg); break;
+            case OPT_HOT_CENTER: opt_access.hot_center = atof(optarg); break;
+            case OPT_HOT_WIDTH: opt_access.hot_width = atof(optarg); break;
+            case OPT_PHASE_ITERATIONS: opt_access.phase_iterations = atol(optarg); break;
+            case OPT_NO_PRECOMPUTE: opt_access.precompute = false; break;
+            case OPT_TRIALS: opt_trials = atoi(optarg); break;
+            case OPT_WARMUP: opt_warmup_trials = atoi(optarg); break;
+            case OPT_MAX_TRIALS: opt_max_trials = atoi(optarg); break;
+            case OPT_TARGET_CI: opt_target_ci = atof(optarg); break;
+            case OPT_CI_METRIC: opt_ci_metric = optarg; break;
+            case OPT_ROTATE_GROUPS: opt_rotate_groups = 1; break;
+            case OPT_THREAD_SWEEP: opt_thread_sweep = 1; break;
+            case OPT_SHARED: opt_shared_region = 1; break;
+            case OPT_POINTER_CHASE: opt_pointer_chase = 1; break;
+            case OPT_FAULT_PROFILE: opt_fault_profile = 1; break;
+            case OPT_FILE_HINTS: opt_file_hints = 1; break;
+            case OPT_IO_ENGINES: opt_io_engines = 1; break;
+            case OPT_IO_BLOCK:
+                opt_io_block = parse_size(optarg);
+                if (opt_io_block == 0 || opt_io_block % 4096 != 0) {
+                    printf("I/O block must be a multiple of 4096: %s\n", optarg);
+                    return false;
+                }
+                break;
+            case OPT_IO_DEPTH: opt_io_depth = atoi(optarg); break;
+            case OPT_IO_WARM: opt_io_warm = 1; break;
+            case OPT_SAMPLE_MEMORY: opt_sample_memory = 1; break;
+            case OPT_SAMPLE_PERIOD: opt_sample_period = strtoull(optarg, nullptr, 0); break;
+            case OPT_HEATMAP: opt_heatmap_prefix = optarg; break;
+            case OPT_STREAM: opt_stream_bandwidth = 1; break;
+            case OPT_RECORD_TRACE: opt_record_trace = optarg; break;
+            case OPT_REPLAY_TRACE: opt_replay_trace = optarg; break;
+            case OPT_RESULTS: opt_results_path = optarg; break;
+            case OPT_FORMAT: opt_results_format = optarg; break;
+            case OPT_TIMESERIES: opt_timeseries_path = optarg; break;
+            case OPT_TIMESERIES_INTERVAL: opt_timeseries_interval_ms = atof(optarg); break;
+            case OPT_FLUSH_MULTIPLE: opt_flush_multiple = atoi(optarg); break;
+            case OPT_FLUSH_CLFLUSH: opt_flush_clflush = 1; break;
+            case OPT_FLUSH_REMAP: opt_flush_remap = 1; break;
+            case OPT_CONTENTION: opt_contention = 1; break;
+            case OPT_CONTENTION_OPS: opt_contention_ops = atol(optarg); break;
+            case OPT_MERGE_INTERVAL: opt_merge_interval = atol(optarg); break;
+            case OPT_CORE_LATENCY: opt_core_latency = 1; break;
+            case OPT_LATENCY_ROUNDS: opt_latency_rounds = atol(optarg); break;
+            case OPT_LATENCY_SAMPLES: opt_latency_samples = atoi(optarg); break;
+            case OPT_OBJECTS:
+                opt_object_size = parse_size(optarg);
+                if (opt_object_size == 0) {
+                    printf("Bad object size: %s\n", optarg);
+                    return false;
+                }
+                break;
+            case OPT_ALLOCATOR: opt_allocator = optarg; break;
+            case OPT_HELP:
+            default:
+                usage(argv[0]);
+                return false;
+        }
+    }
+    if (optind < argc) {
+        printf("Unexpected argument: %s\n", argv[optind]);
+        usage(argv[0]);
+        return false;
+    }
+    if (opt_flush_multiple < 1) {
+        printf("Flush multiple must be at least 1.\n");
+        return false;
+    }
+    if (opt_timeseries_interval_ms <= 0) {
+        printf("Time series interval must be positive.\n");
+        return false;
+    }
+    if (opt_latency_rounds < 1 || opt_latency_samples < 1) {
+        printf("Latency rounds and samples must be positive.\n");
+        return false;
+    }
+    if (opt_contention_ops < 1 || opt_merge_interval < 1) {
+        printf("Contention ops and merge interval must be positive.\n");
+        return false;
+    }
+    if (opt_io_depth < 1 || opt_io_depth > 4096) {
+        printf("I/O depth must be in [1, 4096].\n");
+        return false;
+    }
+    if (opt_trials < 1 || opt_warmup_trials < 0 || opt_access.iterations < 1 ||
+        opt_access.window_lines < 1 || opt_access.locality < 1 || opt_access.line_stride < 1) {
+        printf("Trial counts and walk knobs must be positive.\n");
+        return false;
+    }
+    return true;
+}
+
+// main execution thread.
+int main(int argc, char** argv) {
+    if (!parse_options(argc, argv)) {
+        return EXIT_FAILURE;
+    }
+    const region_type* region = find_region_type(opt_region);
+    if (region == nullptr) {
+        return EXIT_FAILURE;
+    }
+    printf("Region: %s, %zu bytes\n", region->name, opt_size);
+
+    // read before pinning, which would hide every other cpu. the measured
+    // cpu decides the cache sizes that windows and the flush follow.
+    Topology topo;
+    int cpu_id = opt_cpus.empty() ? topo.measure_cpu() : opt_cpus[0];
+    topo.select_cpu(cpu_id);
+    topo.print();
+    if (topo.line_size() != 0 && topo.line_size() != CACHE_LINE_SIZE) {
+        printf("Warning: %zu B cache lines, built for %d B (rebuild with -DCACHE_LINE_SIZE=%zu).\n",
+               topo.line_size(), CACHE_LINE_SIZE, topo.line_size());
+    }
+    if (!opt_window_lines_given) {
+        size_t window = topo.data_cache_size(opt_window_cache);
+        if (window >= CACHE_LINE_SIZE) {
+            opt_access.window_lines = (int) (window / CACHE_LINE_SIZE);
+        }
+        printf("Window: %d lines (%d KiB, %s)\n", opt_access.window_lines,
+               opt_access.window_lines * CACHE_LINE_SIZE >> 10,
+               window >= CACHE_LINE_SIZE ? "sized to the cache" : "cache size unknown, default");
+    }
+
+    // recording needs the window stream in hand before the walk.
+    if (opt_record_trace != nullptr) {
+        opt_access.precompute = true;
+    }
+    MappedTrace trace;
+    if (opt_replay_trace != nullptr) {
+        if (!trace.map(opt_replay_trace)) {
+            return EXIT_FAILURE;
+        }
+        printf("Replaying %" PRIu64 " records from %s.\n", trace.header->records, opt_replay_trace);
+        if (trace.header->region_bytes > opt_size) {
+            printf("Trace covers %" PRIu64 " bytes, wrapping onto a %zu byte region.\n",
+                   trace.header->region_bytes, opt_size);
+        }
+    }
+
+    // (0) scaling mode: one pinned thread per core, swept 1..N.
+    if (opt_thread_sweep) {
+        std::vector<int> cpus = opt_cpus.empty() ? topo.spread() : opt_cpus;
+        char* p = region->allocate(opt_size);
+        if (p == nullptr) {
+            return EXIT_FAILURE;
+        }
+        int result = mem_access_thread_sweep(p, opt_size, cpus, opt_shared_region,
+                                             opt_access_pattern, opt_access, opt_events);
+        region->release(p, opt_size);
+        return result;
+    }
+
+    // bandwidth mode: GB/s per kernel and SIMD variant, swept 1..N threads.
+    if (opt_stream_bandwidth) {
+        std::vector<int> cpus = opt_cpus.empty() ? topo.spread() : opt_cpus;
+        char* p = region->allocate(opt_size);
+        if (p == nullptr) {
+            return EXIT_FAILURE;
+        }
+        int result = stream_bandwidth_sweep(p, opt_size, cpus);
+        region->release(p, opt_size);
+        return result;
+    }
+
+    // coherence mode: no region, just counters bounced between cores.
+    if (opt_contention) {
+        std::vector<int> cpus = opt_cpus.empty() ? topo.spread() : opt_cpus;
+        return contention_sweep(cpus, opt_contention_ops, opt_merge_interval);
+    }
+
+    // placement mode: which cpu pairs hand a line over fastest.
+    if (opt_core_latency) {
+        std::vector<int> cpus = opt_cpus;
+        if (cpus.empty()) {
+            for (size_t c = 0; c < topo.cpus().size(); c++) {
+                cpus.push_back(topo.cpus()[c].cpu);
+            }
+        }
+        return core_latency_matrix(cpus, topo, opt_latency_rounds, opt_latency_samples);
+    }
+
+    // (1) lock the program to a specific CPU.
+    // the time series sampler gets the second --cpus entry, or failing
+    // that another core (not an smt sibling of the measured one if avoidable).
+    int sampler_cpu = -1;
+    if (opt_timeseries_path != nullptr) {
+        sampler_cpu = opt_cpus.size() > 1 ? opt_cpus[1] : topo.helper_cpu(cpu_id);
+        if (sampler_cpu < 0) {
+            printf("No cpu left for the time series sampler; it will share cpu %d.\n", cpu_id);
+        }
+    }
+    pid_t pid = 0;
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(cpu_id, &mask);
+    size_t cpusetsize = sizeof(mask);
+    if (sched_setaffinity(pid, cpusetsize, &mask) == -1) {
+        perror("Oh no. CPU Set Operation Failed.");
+        return EXIT_FAILURE;
+    } else {
+        printf("CPU Set Operation Successful.\n");
+    }  
+
+    // latency mode: ns/load across working set sizes, on the pinned cpu.
+    if (opt_pointer_chase) {
+        char* p = region->allocate(opt_size);
+        if (p == nullptr) {
+            return EXIT_FAILURE;
+        }
+        int result = pointer_chase_sweep(p, opt_size);
+        region->release(p, opt_size);
+        return result;
+    }
+
+    // sampling mode: where in the region the sampled loads (or misses) land.
+    if (opt_sample_memory) {
+        char* p = region->allocate(opt_size);
+        if (p == nullptr) {
+            return EXIT_FAILURE;
+        }
+        std::unique_ptr<AccessPattern> pattern = make_access_pattern(opt_access_pattern, opt_size, opt_access);
+        if (!pattern) {
+            return EXIT_FAILURE;
+        }
+        std::vector<long> bases;
+        if (opt_access.precompute) {
+            bases = precompute_bases(*pattern, opt_access);
+        }
+        MemSampler sampler;
+        if (!sampler.open(opt_sample_period)) {
+            region->release(p, opt_size);
+            return EXIT_FAILURE;
+        }
+        printf("Sampling %s, period %" PRIu64 "%s\n", sampler.source().c_str(), opt_sample_period,
+               sampler.has_weight() ? ", with latency weights" : "");
+        // the reader thread drains the ring every ms; keep it off cpu_id.
+        int reader_cpu = opt_cpus.size() > 1 ? opt_cpus[1] : topo.helper_cpu(cpu_id);
+        if (reader_cpu < 0) {
+            printf("No cpu left for the sample reader; it will share cpu %d.\n", cpu_id);
+        }
+        sampler.start(reader_cpu);
+        double start = now_seconds();
+        run_mem_access(p, *pattern, bases, opt_access);
+        double elapsed = now_seconds() - start;
+        sampler.stop();
+        printf("Access Time: %.3f s, %" PRIu64 " samples lost\n", elapsed, sampler.lost());
+        int result = write_heatmaps(sampler.samples(), p, opt_size, opt_heatmap_prefix, sampler.has_weight());
+        region->release(p, opt_size);
+        return result;
+    }
+
+    // allocator mode: many small objects instead of one region, per allocator.
+    if (opt_object_size != 0) {
+        return small_object_compare(opt_size, opt_object_size, opt_access.locality, opt_allocator, opt_events);
+    }
+
+    // fault mode: first-touch cost of each region type, on the pinned cpu.
+    if (opt_fault_profile) {
+        return page_fault_profile(opt_size, opt_region_given ? region : nullptr);
+    }
+
+    // file modes run sequential and random, plus --pattern if it is neither.
+    std::vector<const char*> file_patterns;
+    file_patterns.push_back("sequential");
+    file_patterns.push_back("random");
+    if (strcmp(opt_access_pattern, "sequential") != 0 && strcmp(opt_access_pattern, "random") != 0) {
+        file_patterns.push_back(opt_access_pattern);
+    }
+
+    // hint mode: cold reads of a data file through mmap, per hint and pattern.
+    if (opt_file_hints) {
+        return file_hint_matrix(opt_size, file_patterns, opt_access);
+    }
+
+    // engine mode: the same reads through each file i/o interface.
+    if (opt_io_engines) {
+        io_config cfg;
+        cfg.block = opt_io_block;
+        cfg.depth = opt_io_depth;
+        cfg.cold = !opt_io_warm;
+        for (size_t pt = 0; pt < file_patterns.size(); pt++) {
+            if (io_engine_compare(opt_size, file_patterns[pt], cfg, opt_access) != EXIT_SUCCESS) {
+                return EXIT_FAILURE;
+            }
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // fixed for the whole run and repeated in every record.
+    ResultsWriter results;
+    if (!results.open(opt_results_path, opt_results_format)) {
+        return EXIT_FAILURE;
+    }
+    ResultRecord run_info = collect_run_metadata();
+    run_info.add("region_type", region->name);
+    run_info.add("region_bytes", (uint64_t) opt_size);
+    run_info.add("pattern", opt_replay_trace != nullptr ? std::string("replay:") + opt_replay_trace
+                                                        : std::string(opt_access_pattern));
+    run_info.add("precompute", opt_access.precompute ? 1 : 0);
+    run_info.add("iterations", opt_access.iterations);
+    run_info.add("window_lines", opt_access.window_lines);
+    run_info.add("llc_bytes", (uint64_t) topo.llc_size());
+    run_info.add("locality", opt_access.locality);
+    run_info.add("line_stride", opt_access.line_stride);
+    run_info.add("write_fraction", opt_access.write_fraction);
+    run_info.add("rotate_groups", opt_rotate_groups);
+    double lines = opt_replay_trace != nullptr ? trace_lines(trace) : mem_access_lines(opt_access);
+    ResultsWriter timeseries;
+    if (opt_timeseries_path != nullptr && !timeseries.open(opt_timeseries_path, opt_results_format)) {
+        return EXIT_FAILURE;
+    }
+
+    // one eviction buffer for the whole run, faulted in here.
+    CacheFlusher flusher;
+    if (!flusher.init(topo, opt_flush_multiple)) {
+        perror("Oh no. Cache Flush Failed.");
+        return EXIT_FAILURE;
+    }
+    flusher.print();
+    run_info.add("flush_bytes", (uint64_t) flusher.buffer_size());
+    run_info.add("flush_clflush", opt_flush_clflush);
+    run_info.add("flush_remap", opt_flush_remap);
+
+    TrialStats stats;
+    int trials = opt_warmup_trials + opt_trials;
+    for (int i = 0; i < trials; i++) {
+        bool warmup = i < opt_warmup_trials;
+
+        // (2) allocate memory pointer for accessing.
+        char *p = region->allocate(opt_size);
+        if (p == nullptr) {
+            return EXIT_FAILURE;
+        }
+
+        // open the l1d + dtlb counters, packed into as few groups as fit.
+        PerfCounterSet counters;
+        if (opt_events.empty()) {
+            counters.add(MEM_ACCESS_EVENTS, NUM_MEM_ACCESS_EVENTS);
+        } else {
+            counters.add(opt_events.data(), opt_events.size());
+        }
+        if (!counters.open()) {
+            return EXIT_FAILURE;
+        }
+        printf("Perf Event Open Successful.\n");
+        printf("%zu Events In %zu Groups.\n", counters.names().size(), counters.num_groups());
+        printf("------------------------\n");
+
+        // resource usage before the walk.
+        struct rusage ru;
+        printf("------------------------\n");
+        if (getrusage(RUSAGE_SELF, &ru) != 0) {
+            perror("Error in system call getrusage");
+            return EXIT_FAILURE;
+        }
+        printf("Utime: %ld.%06ld s\n", ru.ru_utime.tv_sec, ru.ru_utime.tv_usec);
+        printf("Stime: %ld.%06ld s\n", ru.ru_stime.tv_sec, ru.ru_stime.tv_usec);
+        printf("Maxrss: %ld kB\n", ru.ru_maxrss);
+        printf("Minflt: %ld\n", ru.ru_minflt);
+        printf("Majflt: %ld\n", ru.ru_majflt);
+        printf("Inblock: %ld\n", ru.ru_inblock);
+        printf("Outblock: %ld\n", ru.ru_oublock);
+        printf("Voluntary C.S: %ld\n", ru.ru_nvcsw);
+        printf("Involuntary C.S: %ld\n", ru.ru_nivcsw);
+
+        std::unique_ptr<AccessPattern> pattern = make_access_pattern(opt_access_pattern, opt_size, opt_access);
+        if (!pattern) {
+            return EXIT_FAILURE;
+        }
+        // window starts are generated here, outside the counted region.
+        std::vector<long> bases;
+        if (opt_access.precompute) {
+            bases = precompute_bases(*pattern, opt_access);
+        }
+        if (opt_record_trace != nullptr && i == 0) {
+            if (!record_trace(opt_record_trace, bases, opt_access, opt_size)) {
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (opt_rotate_groups) {
+            counters.rotate(i);
+        }
+
+        // (3) flush the cache. last thing before the walk, after allocation
+        // (which may have written the region) and the setup above.
+        flush_report flushed;
+        p = flusher.flush(p, opt_size, *region, opt_flush_clflush, opt_flush_remap, flushed);
+        printf("Cache Flush Successful.\n");
+        printf("Residual Warmth (canary): %.0f ticks/line after flush, %.0f once cached (%.2fx)%s%s\n",
+               flushed.cold_ticks, flushed.warm_ticks,
+               flushed.warm_ticks > 0 ? flushed.cold_ticks / flushed.warm_ticks : 0.0,
+               flushed.flushed_lines ? ", region clflushed" : "", flushed.remapped ? ", remapped" : "");
+
+        // the sampler's first point is taken before enable and its last
+        // after disable, so the series spans the whole counted walk.
+        TimeSeriesSampler sampler;
+        if (opt_timeseries_path != nullptr &&
+            !sampler.start(counters, opt_timeseries_interval_ms / 1e3, sampler_cpu)) {
+            return EXIT_FAILURE;
+        }
+
+        // begin i/o control, all groups start and stop together.
+        counters.reset();
+        counters.enable();
+
+        double start = now_seconds();
+        if (opt_replay_trace != nullptr) {
+            replay_trace(p, opt_size, trace);
+        } else {
+            run_mem_access(p, *pattern, bases, opt_access);
+        }
+        double elapsed = now_seconds() - start;
+
+        counters.disable();
+        sampler.stop();
+
+        printf("Access Time: %.3f s\n", elapsed);
+        print_thp_setting();
+        report_huge_page_backing(p, opt_size);
+
+        // resource usage after the walk, as deltas; maxrss is a high-water
+        // mark, not a counter.
+        struct rusage ru_2;
+        if (getrusage(RUSAGE_SELF, &ru_2) != 0) {
+            perror("Error in system call getrusage");
+            return EXIT_FAILURE;
+        }
+        printf("Utime Delta: %.6f s\n", timeval_seconds(ru_2.ru_utime) - timeval_seconds(ru.ru_utime));
+        printf("Stime Delta: %.6f s\n", timeval_seconds(ru_2.ru_stime) - timeval_seconds(ru.ru_stime));
+        printf("Maxrss: %ld kB\n", ru_2.ru_maxrss);
+        printf("Minflt Delta: %ld\n", ru_2.ru_minflt - ru.ru_minflt);
+        printf("Majflt Delta: %ld\n", ru_2.ru_majflt - ru.ru_majflt);
+        printf("Inblock Delta: %ld\n", ru_2.ru_inblock - ru.ru_inblock);
+        printf("Outblock Delta: %ld\n", ru_2.ru_oublock - ru.ru_oublock);
+        printf("Voluntary C.S Delta: %ld\n", ru_2.ru_nvcsw - ru.ru_nvcsw);
+        printf("Involuntary C.S Delta: %ld\n", ru_2.ru_nivcsw - ru.ru_nivcsw);
+
+        std::map<std::string, uint64_t> values = counters.read();
+        for (std::map<std::string, uint64_t>::const_iterator it = values.begin(); it != values.end(); ++it) {
+            printf("%s: %" PRIu64 "\n", it->first.c_str(), it->second);
+        }
+        // values above are scaled by time_enabled / time_running.
+        for (size_t g = 0; g < counters.num_groups(); g++) {
+            if (counters.active_group() >= 0 && counters.active_group() != (int) g) {
+                continue;
+            }
+            printf("Group %zu Coverage: %.3f (%s)%s\n", g, counters.coverage(g),
+                   counters.group_label(g).c_str(),
+                   counters.coverage(g) < 1.0 ? " [multiplexed]" : "");
+        }
+
+        // buffered; nothing reaches the results file until every trial is done.
+        ResultRecord record;
+        record.add(run_info);
+        record.add("trial", i);
+        record.add("warmup", warmup ? 1 : 0);
+        record.add("cpu", sched_getcpu());
+        record.add("access_time_s", elapsed);
+        record.add("lines_touched", (uint64_t) lines);
+        record.add("lines_per_s", lines / elapsed);
+        add_counter_fields(record, values, lines * CACHE_LINE_SIZE);
+        for (size_t g = 0; g < counters.num_groups(); g++) {
+            if (counters.active_group() >= 0 && counters.active_group() != (int) g) {
+                continue;
+            }
+            record.add("group_" + std::to_string(g) + "_coverage", counters.coverage(g));
+        }
+        record.add("flush_cold_ticks", flushed.cold_ticks);
+        record.add("flush_warm_ticks", flushed.warm_ticks);
+        add_rusage_delta(record, ru, ru_2);
+        results.add(record);
+        if (opt_timeseries_path != nullptr) {
+            ResultRecord context;
+            context.add(run_info);
+            context.add("trial", i);
+            context.add("warmup", warmup ? 1 : 0);
+            sampler.add_records(timeseries, context);
+            printf("Time Series Points: %zu\n", sampler.points().size());
+        }
+        printf("------------------------\n");
+        counters.close_all();
+
+        // deallocate memory pointer.
+        region->release(p, opt_size);
+
+        printf("------------------------\n");
+        if (!warmup) {
+            stats.add("Access Time (s)", elapsed);
+            stats.add(values);
+        }
+        printf("Trial %d complete%s.\n", i, warmup ? " (warmup)" : "");
+        printf("------------------------\n");
+
+        // adaptive mode: one more trial while the CI is still too wide.
+        if (!warmup && opt_target_ci > 0 && i == trials - 1 &&
+            trials < opt_warmup_trials + opt_max_trials) {
+            double width = stats.relative_ci_width(opt_ci_metric);
+            if (width > opt_target_ci) {
+                printf("CI width %.4f above target %.4f, adding a trial.\n", width, opt_target_ci);
+                trials++;
+            }
+        }
+    }
+
+    // statistics over the measured trials.
+    printf("Summary over %d measured trials (%d warmup), 95%% bootstrap CI of the median:\n",
+           trials - opt_warmup_trials, opt_warmup_trials);
+    stats.print();
+    printf("------------------------\n");
+    if (!results.close()) {
+        return EXIT_FAILURE;
+    }
+    if (opt_timeseries_path != nullptr && !timeseries.close()) {
+        return EXIT_FAILURE;
+    }
+    printf("All Trials Complete.\n");
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
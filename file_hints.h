@@ -0,0 +1,179 @@
+#ifndef FILE_HINTS_H
+#define FILE_HINTS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h> // for open, posix_fadvise, readahead
+#include <unistd.h>
+#include <sys/mman.h> // for mmap, madvise, mincore
+#include <sys/stat.h> // for fstat
+#include <sys/resource.h>
+#include <vector>
+
+#include "mem_access.h"
+
+// cold-cache reads of a real data file through mmap under each access hint.
+// sparse ftruncate'd files read back as zero pages without touching the
+// disk, so this writes actual data once and evicts it from the page cache
+// before every run.
+#define FILE_HINT_PATH "file_hint_testing.dat"
+#define FILE_HINT_CHUNK (1 << 20)
+
+enum file_hint_kind { HINT_MADVISE, HINT_POPULATE, HINT_READAHEAD };
+
+struct file_hint {
+    const char* name;
+    file_hint_kind kind;
+    int advice;         // madvise advice for HINT_MADVISE
+};
+
+static const file_hint FILE_HINTS[] = {
+    {"MADV_NORMAL", HINT_MADVISE, MADV_NORMAL},
+    {"MADV_SEQUENTIAL", HINT_MADVISE, MADV_SEQUENTIAL},
+    {"MADV_RANDOM", HINT_MADVISE, MADV_RANDOM},
+    {"MADV_WILLNEED", HINT_MADVISE, MADV_WILLNEED},
+    {"MAP_POPULATE", HINT_POPULATE, 0},
+    {"readahead()", HINT_READAHEAD, 0},
+};
+
+static const size_t NUM_FILE_HINTS = sizeof(FILE_HINTS) / sizeof(FILE_HINTS[0]);
+
+// open the data file, (re)writing it with non-zero data unless it already
+// has the right size. -1 on failure.
+static inline int open_hint_file(size_t size) {
+    int fd = open(FILE_HINT_PATH, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        perror("Oh no. File Open Failed.");
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size == size) {
+        return fd;
+    }
+    printf("Writing %zu MiB of data to %s.\n", size >> 20, FILE_HINT_PATH);
+    if (ftruncate(fd, 0) == -1) {
+        perror("Oh no. File Truncate Failed.");
+        close(fd);
+        return -1;
+    }
+    std::vector<char> chunk(FILE_HINT_CHUNK);
+    for (size_t i = 0; i < chunk.size(); i++) {
+        chunk[i] = (char) (i * 31 + 7);
+    }
+    for (size_t done = 0; done < size; ) {
+        size_t n = size - done < chunk.size() ? size - done : chunk.size();
+        ssize_t w = write(fd, chunk.data(), n);
+        if (w <= 0) {
+            perror("Oh no. File Write Failed.");
+            close(fd);
+            return -1;
+        }
+        done += w;
+    }
+    return fd;
+}
+
+// write back and evict the file from the page cache.
+static inline void drop_file_cache(int fd) {
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+}
+
+// fraction of the file's pages in the page cache, via a throwaway mapping.
+static inline double file_resident_fraction(int fd, size_t size) {
+    void* p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        return -1;
+    }
+    size_t page = sysconf(_SC_PAGE_SIZE);
+    size_t pages = (size + page - 1) / page;
+    std::vector<unsigned char> vec(pages);
+    size_t resident = 0;
+    if (mincore(p, size, vec.data()) == 0) {
+        for (size_t i = 0; i < pages; i++) {
+            resident += vec[i] & 1;
+        }
+    }
+    munmap(p, size);
+    return (double) resident / pages;
+}
+
+// one cold run: evict, map with the hint, walk read-only. setup (the hint
+// call itself, which is where WILLNEED / populate / readahead do their
+// reading) and walk are timed separately; throughput is over both.
+static inline int run_file_hint(int fd, size_t size, const file_hint& hint, const char* pattern_name,
+                                const access_params& params) {
+    std::unique_ptr<AccessPattern> pattern = make_access_pattern(pattern_name, size, params);
+    if (!pattern) {
+        return EXIT_FAILURE;
+    }
+    std::vector<long> bases = precompute_bases(*pattern, params);
+
+    drop_file_cache(fd);
+    double cold = file_resident_fraction(fd, size);
+
+    struct rusage ru, ru_2;
+    getrusage(RUSAGE_SELF, &ru);
+    double t0 = now_seconds();
+    int flags = MAP_SHARED | (hint.kind == HINT_POPULATE ? MAP_POPULATE : 0);
+    char* p = (char*) mmap(nullptr, size, PROT_READ, flags, fd, 0);
+    if (p == MAP_FAILED) {
+        perror("Oh no. Memory Allocation Failed.");
+        return EXIT_FAILURE;
+    }
+    if (hint.kind == HINT_MADVISE && madvise(p, size, hint.advice) == -1) {
+        perror("Oh no. madvise Failed.");
+    } else if (hint.kind == HINT_READAHEAD && readahead(fd, 0, size) == -1) {
+        perror("Oh no. readahead Failed.");
+    }
+    double setup = now_seconds() - t0;
+
+    t0 = now_seconds();
+    do_mem_access(p, bases.data(), params);
+    double walk = now_seconds() - t0;
+    getrusage(RUSAGE_SELF, &ru_2);
+    munmap(p, size);
+
+    double bytes = mem_access_lines(params) * CACHE_LINE_SIZE;
+    printf("%-16s %-11s %7.1f%% %10.1f %10.1f %10.1f %10ld %10ld %7.1f%%\n", hint.name, pattern_name,
+           cold * 100, setup * 1e3, walk * 1e3, bytes / (setup + walk) / (1024 * 1024),
+           ru_2.ru_majflt - ru.ru_majflt, ru_2.ru_minflt - ru.ru_minflt,
+           file_resident_fraction(fd, size) * 100);
+    fflush(stdout);
+    return EXIT_SUCCESS;
+}
+
+// every hint against each pattern, on a size byte data file. the walk is
+// read-only (the mapping is PROT_READ) and covers one file's worth of
+// windows, each read once (locality 1), so the cold misses are not drowned
+// out by cached re-reads and MiB/s is file bytes touched.
+static inline int file_hint_matrix(size_t size, const std::vector<const char*>& patterns,
+                                   const access_params& base_params) {
+    int fd = open_hint_file(size);
+    if (fd == -1) {
+        return EXIT_FAILURE;
+    }
+    access_params params = base_params;
+    params.precompute = true;
+    params.write_fraction = 0;
+    params.locality = 1;
+    long windows = (long) (size / CACHE_LINE_SIZE) / ((long) params.window_lines * params.line_stride);
+    params.iterations = windows > 0 ? windows : 1;
+
+    printf("File Hint Matrix, %zu MiB file, %ld windows of %d lines per run\n", size >> 20,
+           params.iterations, params.window_lines);
+    printf("%-16s %-11s %8s %10s %10s %10s %10s %10s %8s\n", "Hint", "Pattern", "Cold Res",
+           "Setup ms", "Walk ms", "MiB/s", "Major F", "Minor F", "Res After");
+    for (size_t pt = 0; pt < patterns.size(); pt++) {
+        for (size_t h = 0; h < NUM_FILE_HINTS; h++) {
+            run_file_hint(fd, size, FILE_HINTS[h], patterns[pt], params);
+        }
+    }
+    drop_file_cache(fd);
+    close(fd);
+    printf("------------------------\n");
+    return EXIT_SUCCESS;
+}
+
+#endif // FILE_HINTS_H
@@ -0,0 +1,428 @@
+#ifndef IO_ENGINES_H
+#define IO_ENGINES_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h> // for open, O_DIRECT
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h> // for preadv
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <cstdint> // for uint64_t
+#include <algorithm> // for std::sort
+#include <string>
+#include <vector>
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+
+#include "mem_access.h"
+#include "file_hints.h" // for open_hint_file, drop_file_cache
+#include "trial_stats.h" // for percentile
+
+#if defined(IORING_OFF_SQ_RING) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define HAVE_IO_URING 1
+#endif
+
+// block reads of the data file through different engines: the same
+// offsets, the same block size, one engine after another, each starting
+// from a cold page cache.
+struct io_config {
+    size_t block;       // bytes per read, a multiple of 4096 for O_DIRECT
+    int depth;          // reads in flight (io_uring) or per call (preadv)
+    bool cold;          // evict the file before every engine
+};
+
+// per-engine totals; latencies are per request, or per call for preadv.
+struct io_result {
+    std::string engine;
+    bool ok;
+    size_t ops;
+    double seconds;
+    double cpu_seconds;
+    std::vector<double> latency_us;
+};
+
+static inline double rusage_cpu_seconds() {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+// block offsets in the order the access pattern visits them.
+static inline std::vector<off_t> io_offsets(const char* pattern_name, size_t size, const io_config& cfg,
+                                            const access_params& base_params) {
+    access_params params = base_params;
+    params.window_lines = (int) (cfg.block / CACHE_LINE_SIZE);
+    params.line_stride = 1;
+    long blocks = (long) (size / cfg.block);
+    params.iterations = blocks < base_params.iterations ? blocks : base_params.iterations;
+    std::vector<off_t> offsets;
+    std::unique_ptr<AccessPattern> pattern = make_access_pattern(pattern_name, size, params);
+    if (!pattern) {
+        return offsets;
+    }
+    std::vector<long> bases = precompute_bases(*pattern, params);
+    offsets.resize(bases.size());
+    for (size_t i = 0; i < bases.size(); i++) {
+        offsets[i] = (off_t) (bases[i] * CACHE_LINE_SIZE) / cfg.block * cfg.block;
+    }
+    return offsets;
+}
+
+static inline char* io_buffer(size_t bytes) {
+    void* buf = nullptr;
+    if (posix_memalign(&buf, 4096, bytes) != 0) {
+        return nullptr;
+    }
+    memset(buf, 0, bytes);
+    return (char*) buf;
+}
+
+// copy each block out of a shared read-only mapping.
+static inline bool io_mmap(int fd, size_t size, const std::vector<off_t>& offsets, const io_config& cfg,
+                           io_result& r) {
+    char* p = (char*) mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        perror("Oh no. Memory Allocation Failed.");
+        return false;
+    }
+    char* buf = io_buffer(cfg.block);
+    for (size_t i = 0; i < offsets.size(); i++) {
+        double t0 = now_seconds();
+        memcpy(buf, p + offsets[i], cfg.block);
+        r.latency_us.push_back((now_seconds() - t0) * 1e6);
+    }
+    free(buf);
+    munmap(p, size);
+    r.ops = offsets.size();
+    return true;
+}
+
+// one pread per block; used for buffered and O_DIRECT descriptors.
+static inline bool io_pread(int fd, const std::vector<off_t>& offsets, const io_config& cfg, io_result& r) {
+    char* buf = io_buffer(cfg.block);
+    for (size_t i = 0; i < offsets.size(); i++) {
+        double t0 = now_seconds();
+        if (pread(fd, buf, cfg.block, offsets[i]) != (ssize_t) cfg.block) {
+            perror("Oh no. pread Failed.");
+            free(buf);
+            return false;
+        }
+        r.latency_us.push_back((now_seconds() - t0) * 1e6);
+    }
+    free(buf);
+    r.ops = offsets.size();
+    return true;
+}
+
+// preadv reads one contiguous range, so runs of adjacent blocks (up to
+// depth of them) go out as a single call, each into its own buffer. random
+// offsets degrade to one block per call.
+static inline bool io_preadv(int fd, const std::vector<off_t>& offsets, const io_config& cfg, io_result& r) {
+    char* buf = io_buffer(cfg.block * cfg.depth);
+    std::vector<struct iovec> iov(cfg.depth);
+    for (int d = 0; d < cfg.depth; d++) {
+        iov[d].iov_base = buf + d * cfg.block;
+        iov[d].iov_len = cfg.block;
+    }
+    size_t i = 0;
+    while (i < offsets.size()) {
+        int n = 1;
+        while (n < cfg.depth && i + n < offsets.size() &&
+               offsets[i + n] == offsets[i] + (off_t) (n * cfg.block)) {
+            n++;
+        }
+        double t0 = now_seconds();
+        if (preadv(fd, iov.data(), n, offsets[i]) != (ssize_t) (n * cfg.block)) {
+            perror("Oh no. preadv Failed.");
+            free(buf);
+            return false;
+        }
+        r.latency_us.push_back((now_seconds() - t0) * 1e6);
+        i += n;
+    }
+    free(buf);
+    r.ops = offsets.size();
+    return true;
+}
+
+#ifdef HAVE_IO_URING
+// a bare io_uring: setup, the two ring mappings and the sqe array, driven
+// with io_uring_enter directly so there is no liburing dependency.
+class IoUring {
+public:
+    IoUring() : fd_(-1), sq_ptr_(MAP_FAILED), cq_ptr_(MAP_FAILED), sqes_(nullptr), sq_len_(0), cq_len_(0),
+                sqes_len_(0) {}
+    ~IoUring() { close_ring(); }
+
+    // false (errno set) when the kernel or a seccomp policy refuses.
+    bool setup(unsigned entries) {
+        struct io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        fd_ = (int) syscall(__NR_io_uring_setup, entries, &params);
+        if (fd_ < 0) {
+            return false;
+        }
+        sq_len_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_len_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        sqes_len_ = params.sq_entries * sizeof(struct io_uring_sqe);
+        sq_ptr_ = mmap(nullptr, sq_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+        cq_ptr_ = mmap(nullptr, cq_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+        void* sqes = mmap(nullptr, sqes_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+        if (sq_ptr_ == MAP_FAILED || cq_ptr_ == MAP_FAILED || sqes == MAP_FAILED) {
+            if (sqes != MAP_FAILED) {
+                munmap(sqes, sqes_len_);
+            }
+            close_ring();
+            return false;
+        }
+        sqes_ = (struct io_uring_sqe*) sqes;
+        char* sq = (char*) sq_ptr_;
+        char* cq = (char*) cq_ptr_;
+        sq_tail_ = (unsigned*) (sq + params.sq_off.tail);
+        sq_mask_ = *(unsigned*) (sq + params.sq_off.ring_mask);
+        sq_array_ = (unsigned*) (sq + params.sq_off.array);
+        cq_head_ = (unsigned*) (cq + params.cq_off.head);
+        cq_tail_ = (unsigned*) (cq + params.cq_off.tail);
+        cq_mask_ = *(unsigned*) (cq + params.cq_off.ring_mask);
+        cqes_ = (struct io_uring_cqe*) (cq + params.cq_off.cqes);
+        return true;
+    }
+
+    // queue one readv; submitted on the next enter().
+    void prep_readv(int fd, const struct iovec* iov, off_t offset, uint64_t user_data) {
+        unsigned tail = *sq_tail_;
+        unsigned index = tail & sq_mask_;
+        struct io_uring_sqe* sqe = &sqes_[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READV;
+        sqe->fd = fd;
+        sqe->addr = (uint64_t) (uintptr_t) iov;
+        sqe->len = 1;
+        sqe->off = (uint64_t) offset;
+        sqe->user_data = user_data;
+        sq_array_[index] = index;
+        __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    }
+
+    int enter(unsigned to_submit, unsigned min_complete) {
+        return (int) syscall(__NR_io_uring_enter, fd_, to_submit, min_complete,
+                             min_complete ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+    }
+
+    // next completion, if any; call cqe_seen() when done with it.
+    bool peek(struct io_uring_cqe& out) {
+        unsigned head = *cq_head_;
+        if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+        out = cqes_[head & cq_mask_];
+        return true;
+    }
+
+    void cqe_seen() { __atomic_store_n(cq_head_, *cq_head_ + 1, __ATOMIC_RELEASE); }
+
+    // unmap and close; the kernel cancels whatever is still in flight.
+    void close_ring() {
+        if (sqes_ != nullptr) {
+            munmap(sqes_, sqes_len_);
+        }
+        if (sq_ptr_ != MAP_FAILED) {
+            munmap(sq_ptr_, sq_len_);
+        }
+        if (cq_ptr_ != MAP_FAILED) {
+            munmap(cq_ptr_, cq_len_);
+        }
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+        sqes_ = nullptr;
+        sq_ptr_ = cq_ptr_ = MAP_FAILED;
+        fd_ = -1;
+    }
+
+private:
+    int fd_;
+    void* sq_ptr_;
+    void* cq_ptr_;
+    struct io_uring_sqe* sqes_;
+    size_t sq_len_, cq_len_, sqes_len_;
+    unsigned* sq_tail_;
+    unsigned sq_mask_;
+    unsigned* sq_array_;
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned cq_mask_;
+    struct io_uring_cqe* cqes_;
+};
+#endif
+
+// keep depth reads in flight through io_uring; latency is submit to reap.
+// returns false with unavailable set when io_uring cannot be set up.
+static inline bool io_uring_reads(int fd, const std::vector<off_t>& offsets, const io_config& cfg, io_result& r,
+                                  bool& unavailable) {
+    unavailable = false;
+#ifdef HAVE_IO_URING
+    IoUring ring;
+    if (!ring.setup((unsigned) cfg.depth)) {
+        unavailable = true;
+        return false;
+    }
+    char* buf = io_buffer(cfg.block * cfg.depth);
+    std::vector<struct iovec> iov(cfg.depth);
+    std::vector<double> started(cfg.depth);
+    std::vector<int> free_slots;
+    for (int d = cfg.depth - 1; d >= 0; d--) {
+        iov[d].iov_base = buf + d * cfg.block;
+        iov[d].iov_len = cfg.block;
+        free_slots.push_back(d);
+    }
+    // after the first error nothing more is submitted, but every read
+    // already in flight is reaped before buf goes away.
+    size_t next = 0, done = 0, inflight = 0;
+    bool ok = true, stuck = false;
+    while (inflight > 0 || (ok && next < offsets.size())) {
+        unsigned queued = 0;
+        while (ok && !free_slots.empty() && next < offsets.size()) {
+            int slot = free_slots.back();
+            free_slots.pop_back();
+            started[slot] = now_seconds();
+            ring.prep_readv(fd, &iov[slot], offsets[next++], (uint64_t) slot);
+            queued++;
+        }
+        inflight += queued;
+        if (ring.enter(queued, 1) < 0 && errno != EINTR) {
+            perror("Oh no. io_uring_enter Failed.");
+            if (!ok) {
+                stuck = true;
+                break;
+            }
+            // a refused enter submitted nothing.
+            ok = false;
+            inflight -= queued;
+            continue;
+        }
+        struct io_uring_cqe cqe;
+        while (ring.peek(cqe)) {
+            int slot = (int) cqe.user_data;
+            if (cqe.res != (int) cfg.block) {
+                printf("io_uring read returned %d\n", cqe.res);
+                ok = false;
+            }
+            r.latency_us.push_back((now_seconds() - started[slot]) * 1e6);
+            free_slots.push_back(slot);
+            ring.cqe_seen();
+            inflight--;
+            done++;
+        }
+    }
+    if (stuck) {
+        // reads could still land in buf: tear the ring down and keep buf.
+        ring.close_ring();
+        printf("io_uring reads could not be drained, read buffer left allocated.\n");
+    } else {
+        free(buf);
+    }
+    r.ops = done;
+    return ok;
+#else
+    (void) fd; (void) offsets; (void) cfg; (void) r;
+    unavailable = true;
+    return false;
+#endif
+}
+
+static inline void print_io_result(const io_result& r, size_t block) {
+    if (!r.ok) {
+        printf("%-26s unavailable\n", r.engine.c_str());
+        return;
+    }
+    std::vector<double> lat(r.latency_us);
+    std::sort(lat.begin(), lat.end());
+    printf("%-26s %10.0f %9.1f %9.1f %9.1f %9.1f %9.1f %10.2f %7.1f%%\n", r.engine.c_str(), r.ops / r.seconds,
+           r.ops * (double) block / r.seconds / (1024 * 1024), percentile(lat, 0.5), percentile(lat, 0.99),
+           percentile(lat, 0.999), lat.empty() ? 0.0 : lat.back(), r.cpu_seconds * 1e6 / r.ops,
+           100 * r.cpu_seconds / r.seconds);
+    fflush(stdout);
+}
+
+// run every engine over the same offsets for one pattern.
+static inline int io_engine_compare(size_t size, const char* pattern_name, const io_config& cfg,
+                                    const access_params& params) {
+    int fd = open_hint_file(size);
+    if (fd == -1) {
+        return EXIT_FAILURE;
+    }
+    std::vector<off_t> offsets = io_offsets(pattern_name, size, cfg, params);
+    if (offsets.empty()) {
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    // O_DIRECT is refused by some filesystems (tmpfs); those engines are skipped.
+    int direct_fd = open(FILE_HINT_PATH, O_RDONLY | O_DIRECT);
+
+    printf("I/O Engines, %zu MiB file, %s, %zu reads of %zu bytes, depth %d, %s cache\n", size >> 20,
+           pattern_name, offsets.size(), cfg.block, cfg.depth, cfg.cold ? "cold" : "warm");
+    printf("%-26s %10s %9s %9s %9s %9s %9s %10s %8s\n", "Engine", "IOPS", "MiB/s", "P50 us", "P99 us",
+           "P99.9 us", "Max us", "CPU us/op", "CPU");
+    static const char* const ENGINES[] = {
+        "mmap", "pread", "preadv", "pread O_DIRECT", "io_uring", "io_uring O_DIRECT"
+    };
+    for (size_t e = 0; e < sizeof(ENGINES) / sizeof(ENGINES[0]); e++) {
+        io_result r;
+        r.engine = ENGINES[e];
+        r.ops = 0;
+        bool direct = strstr(ENGINES[e], "O_DIRECT") != nullptr;
+        int use_fd = direct ? direct_fd : fd;
+        if (use_fd == -1) {
+            r.ok = false;
+            print_io_result(r, cfg.block);
+            continue;
+        }
+        if (cfg.cold) {
+            drop_file_cache(fd);
+        }
+        double cpu0 = rusage_cpu_seconds();
+        double t0 = now_seconds();
+        if (e == 0) {
+            r.ok = io_mmap(use_fd, size, offsets, cfg, r);
+        } else if (e == 1 || e == 3) {
+            r.ok = io_pread(use_fd, offsets, cfg, r);
+        } else if (e == 2) {
+            r.ok = io_preadv(use_fd, offsets, cfg, r);
+        } else {
+            bool unavailable;
+            r.ok = io_uring_reads(use_fd, offsets, cfg, r, unavailable);
+            if (unavailable) {
+                // same offsets through pread, so the row still means something.
+                printf("io_uring unavailable (%s), falling back to pread.\n", strerror(errno));
+                r.engine += " (pread)";
+                r.latency_us.clear();
+                if (cfg.cold) {
+                    drop_file_cache(fd);
+                }
+                cpu0 = rusage_cpu_seconds();
+                t0 = now_seconds();
+                r.ok = io_pread(use_fd, offsets, cfg, r);
+            }
+        }
+        r.seconds = now_seconds() - t0;
+        r.cpu_seconds = rusage_cpu_seconds() - cpu0;
+        print_io_result(r, cfg.block);
+    }
+    if (direct_fd != -1) {
+        close(direct_fd);
+    }
+    drop_file_cache(fd);
+    close(fd);
+    printf("------------------------\n");
+    return EXIT_SUCCESS;
+}
+
+#endif // IO_ENGINES_H
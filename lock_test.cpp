@@ -3,51 +3,387 @@
 // allows us to use affinity and getcpu() to test.
 #include <sched.h>
 #include <unistd.h>
+#include <getopt.h> // for getopt_long
+#include <string.h>
+#include <time.h> // for nanosleep
+#include <cstdint> // for uint64_t
+#include <algorithm> // for std::sort
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
 
-static int flush_the_cache() {
-    size_t kb_to_flush = 64 * 1024;
-    char* buffer = (char*) malloc(kb_to_flush);
-    if (buffer == nullptr) {
-        printf("Failed to allocate for cache flush.\n");
-        return EXIT_FAILURE;
+#include "locks.h"
+#include "mem_access.h" // for pin_to_cpu, now_seconds
+#include "pointer_chase.h" // for read_tsc, tsc_per_ns
+#include "topology.h"
+#include "trial_stats.h" // for percentile
+
+// lock contention suite. for every lock, thread count, critical section
+// length and time outside the lock, N pinned threads loop: acquire, do cs
+// units of work on the protected data, release, do outside units of
+// private work. reports throughput, fairness (spread of per-thread
+// acquisitions and jain's index) and handoff latency: the time from one
+// thread's release to a different thread's acquire, read with rdtsc.
+//   ./lock_test --threads 1,4,16,32 --cs 10,1000 --outside 0,1000
+
+// handoff samples kept per thread per run.
+#define HANDOFF_SAMPLES (1 << 18)
+
+struct lock_config {
+    int threads;
+    long cs;
+    long outside;
+    double duration;
+    double read_fraction;
+    std::vector<int> cpus;
+};
+
+struct lock_result {
+    double seconds;
+    std::vector<uint64_t> acquisitions;   // per thread
+    std::vector<double> handoff_ns;       // sorted
+    bool consistent;                      // protected data matches the writes made
+};
+
+// what the lock protects: one line of data the critical section works on,
+// and the handoff bookkeeping, which is only touched with the lock held
+// exclusively.
+struct protected_state {
+    alignas(64) volatile uint64_t data[8];
+    alignas(64) uint64_t writes;
+    uint64_t last_release;
+    int last_owner;
+};
+
+// units of private work between acquisitions, kept opaque to the compiler.
+static inline void outside_work(long units) {
+    uint64_t x = 0;
+    for (long i = 0; i < units; i++) {
+        x = x * 31 + i;
+        asm volatile("" : "+r" (x));
     }
-    for (size_t i = 0; i < kb_to_flush; i++) {
-        buffer[i] = (char) i;
+}
+
+template <class Lock>
+static lock_result run_lock(const lock_config& cfg, double ticks_per_ns) {
+    Lock lock;
+    protected_state state;
+    memset((void*) &state, 0, sizeof(state));
+    state.last_owner = -1;
+
+    std::vector<lock_node> nodes(cfg.threads);
+    std::vector<uint64_t> acquisitions(cfg.threads, 0);
+    std::vector<std::vector<uint64_t> > handoffs(cfg.threads);
+    std::vector<double> finished(cfg.threads, 0);
+    uint64_t read_threshold = (uint64_t) (cfg.read_fraction * (double) UINT64_MAX);
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < cfg.threads; t++) {
+        threads.push_back(std::thread([&, t]() {
+            if (pin_to_cpu(cfg.cpus[t % cfg.cpus.size()]) == -1) {
+                perror("Oh no. CPU Set Operation Failed.");
+            }
+            Xoshiro256ss rng(t + 1);
+            lock_node& node = nodes[t];
+            std::vector<uint64_t>& mine = handoffs[t];
+            mine.reserve(HANDOFF_SAMPLES);
+            uint64_t count = 0;
+            ready++;
+            while (!go.load(std::memory_order_acquire)) {
+            }
+            while (!stop.load(std::memory_order_relaxed)) {
+                if (read_threshold > 0 && rng.next() < read_threshold) {
+                    lock.lock_shared(node);
+                    uint64_t sum = 0;
+                    for (long k = 0; k < cfg.cs; k++) {
+                        sum += state.data[k & 7];
+                    }
+                    asm volatile("" : : "r" (sum));
+                    lock.unlock_shared(node);
+                } else {
+                    lock.lock(node);
+                    uint64_t now = read_tsc();
+                    if (state.last_owner >= 0 && state.last_owner != t && mine.size() < HANDOFF_SAMPLES) {
+                        mine.push_back(now - state.last_release);
+                    }
+                    for (long k = 0; k < cfg.cs; k++) {
+                        state.data[k & 7] = state.data[k & 7] + 1;
+                    }
+                    state.writes++;
+                    state.last_owner = t;
+                    state.last_release = read_tsc();
+                    lock.unlock(node);
+                }
+                count++;
+                outside_work(cfg.outside);
+            }
+            acquisitions[t] = count;
+            finished[t] = now_seconds();
+        }));
     }
-    free(buffer);
-    return EXIT_SUCCESS;
+    while (ready.load() < cfg.threads) {
+    }
+    double start = now_seconds();
+    go.store(true, std::memory_order_release);
+    struct timespec pause;
+    pause.tv_sec = (time_t) cfg.duration;
+    pause.tv_nsec = (long) ((cfg.duration - pause.tv_sec) * 1e9);
+    nanosleep(&pause, nullptr);
+    stop.store(true, std::memory_order_relaxed);
+    for (size_t t = 0; t < threads.size(); t++) {
+        threads[t].join();
+    }
+
+    lock_result r;
+    r.seconds = *std::max_element(finished.begin(), finished.end()) - start;
+    r.acquisitions = acquisitions;
+    for (int t = 0; t < cfg.threads; t++) {
+        for (size_t i = 0; i < handoffs[t].size(); i++) {
+            r.handoff_ns.push_back(ticks_per_ns > 0 ? handoffs[t][i] / ticks_per_ns : 0);
+        }
+    }
+    std::sort(r.handoff_ns.begin(), r.handoff_ns.end());
+    uint64_t sum = 0;
+    for (int k = 0; k < 8; k++) {
+        sum += state.data[k];
+    }
+    r.consistent = sum == state.writes * (uint64_t) cfg.cs;
+    return r;
 }
 
-int main() {
+struct lock_kind {
+    const char* name;
+    lock_result (*run)(const lock_config& cfg, double ticks_per_ns);
+};
 
-	int result = flush_the_cache();
-	if (result == EXIT_SUCCESS) {
-		printf("flushed successfully\n");
+static const lock_kind LOCK_KINDS[] = {
+    {"std_mutex", run_lock<StdMutexLock>},
+    {"pthread_adaptive", run_lock<PthreadAdaptiveLock>},
+    {"futex", run_lock<FutexLock>},
+    {"ttas", run_lock<TtasSpinLock>},
+    {"ticket", run_lock<TicketLock>},
+    {"mcs", run_lock<McsLock>},
+    {"rwlock", run_lock<RwLock>},
+};
 
-	}
-	int cpu_id = 4;
-	pid_t pid = 0;
-	cpu_set_t mask;
-	CPU_ZERO(&mask);
-	CPU_SET(cpu_id, &mask);
-	size_t cpusetsize = sizeof(mask);
-	if(sched_setaffinity(pid, cpusetsize, &mask) == -1) {
-		perror("Oh no. CPU Set Operation Failed.");
-		return EXIT_FAILURE;
-	}
+static const size_t NUM_LOCK_KINDS = sizeof(LOCK_KINDS) / sizeof(LOCK_KINDS[0]);
 
-	// some basic operations :)
-        for (int i = 0; i < 10; i++) {
-                printf("%d", i);
+std::vector<const lock_kind*> opt_locks;   // empty = all
+std::vector<int> opt_threads;              // empty = 1, 2, 4, ... cpus
+std::vector<long> opt_cs;
+std::vector<long> opt_outside;
+std::vector<int> opt_cpus;                 // empty = every cpu, one per core first
+double opt_duration = 0.2;                 // seconds per run
+double opt_read_fraction = 0;              // shared acquisitions (real ones only for rwlock)
+
+// "10,100,1000" -> {10, 100, 1000}. false on anything malformed or negative.
+static bool parse_long_list(const char* s, std::vector<long>& out) {
+    out.clear();
+    while (*s != '\0') {
+        char* end;
+        long v = strtol(s, &end, 10);
+        if (end == s || v < 0) {
+            return false;
         }
-        printf("\n");
-        for (int i = 0; i < 10; i++) {
-                printf("%d", i);
+        out.push_back(v);
+        s = *end == ',' ? end + 1 : end;
+        if (*end != ',' && *end != '\0') {
+            return false;
         }
-        printf("\n");
+    }
+    return !out.empty();
+}
 
-	printf("Basic Operations Complete. \n");
-	printf("CPU that was used: %d\n", sched_getcpu());
+static bool parse_lock_list(const char* s, std::vector<const lock_kind*>& out) {
+    out.clear();
+    std::string list(s);
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t comma = list.find(',', start);
+        std::string name = list.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+        const lock_kind* kind = nullptr;
+        for (size_t i = 0; i < NUM_LOCK_KINDS; i++) {
+            if (name == LOCK_KINDS[i].name) {
+                kind = &LOCK_KINDS[i];
+            }
+        }
+        if (kind == nullptr) {
+            printf("Unknown lock %s.\n", name.c_str());
+            return false;
+        }
+        out.push_back(kind);
+        if (comma == std::string::npos) {
+            break;
+        }
+        start = comma + 1;
+    }
+    return true;
+}
 
-	return 0;
-}
\ No newline at end of file
+static void usage(const char* argv0) {
+    printf("usage: %s [options]\n", argv0);
+    printf("  --locks LIST           comma separated, default all:");
+    for (size_t i = 0; i < NUM_LOCK_KINDS; i++) {
+        printf(" %s", LOCK_KINDS[i].name);
+    }
+    printf("\n");
+    printf("  --threads LIST         thread counts (default 1, 2, 4, ... up to the cpus)\n");
+    printf("  --cs LIST              work units inside the lock (default 10,1000)\n");
+    printf("  --outside LIST         work units between acquisitions (default 0,1000)\n");
+    printf("  --cpus LIST            cpus to pin to, round robin (default all, one per core first)\n");
+    printf("  --duration S           seconds per run (default 0.2)\n");
+    printf("  --read-fraction F      fraction of acquisitions that only read (default 0)\n");
+}
+
+static bool parse_options(int argc, char** argv) {
+    static const struct option options[] = {
+        {"locks", required_argument, nullptr, 'l'},
+        {"threads", required_argument, nullptr, 't'},
+        {"cs", required_argument, nullptr, 's'},
+        {"outside", required_argument, nullptr, 'o'},
+        {"cpus", required_argument, nullptr, 'c'},
+        {"duration", required_argument, nullptr, 'd'},
+        {"read-fraction", required_argument, nullptr, 'r'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0},
+    };
+    std::vector<long> threads;
+    int c;
+    while ((c = getopt_long(argc, argv, "", options, nullptr)) != -1) {
+        switch (c) {
+            case 'l':
+                if (!parse_lock_list(optarg, opt_locks)) {
+                    return false;
+                }
+                break;
+            case 't':
+                if (!parse_long_list(optarg, threads)) {
+                    printf("Bad thread list: %s\n", optarg);
+                    return false;
+                }
+                opt_threads.assign(threads.begin(), threads.end());
+                break;
+            case 's':
+                if (!parse_long_list(optarg, opt_cs)) {
+                    printf("Bad critical section list: %s\n", optarg);
+                    return false;
+                }
+                break;
+            case 'o':
+                if (!parse_long_list(optarg, opt_outside)) {
+                    printf("Bad outside work list: %s\n", optarg);
+                    return false;
+                }
+                break;
+            case 'c':
+                if (!parse_cpu_list(optarg, opt_cpus)) {
+                    printf("Bad cpu list: %s\n", optarg);
+                    return false;
+                }
+                break;
+            case 'd': opt_duration = atof(optarg); break;
+            case 'r': opt_read_fraction = atof(optarg); break;
+            default:
+                usage(argv[0]);
+                return false;
+        }
+    }
+    for (size_t i = 0; i < opt_threads.size(); i++) {
+        if (opt_threads[i] < 1) {
+            printf("Thread counts must be positive.\n");
+            return false;
+        }
+    }
+    if (opt_duration <= 0 || opt_read_fraction < 0 || opt_read_fraction > 1) {
+        printf("Duration must be positive and the read fraction in [0, 1].\n");
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (!parse_options(argc, argv)) {
+        return EXIT_FAILURE;
+    }
+    Topology topo;
+    if (opt_cpus.empty()) {
+        opt_cpus = topo.spread();
+    }
+    if (opt_cpus.empty()) {
+        printf("No CPUs available.\n");
+        return EXIT_FAILURE;
+    }
+    if (opt_threads.empty()) {
+        for (size_t n = 1; n < opt_cpus.size(); n *= 2) {
+            opt_threads.push_back((int) n);
+        }
+        opt_threads.push_back((int) opt_cpus.size());
+    }
+    if (opt_locks.empty()) {
+        for (size_t i = 0; i < NUM_LOCK_KINDS; i++) {
+            opt_locks.push_back(&LOCK_KINDS[i]);
+        }
+    }
+    if (opt_cs.empty()) {
+        opt_cs.push_back(10);
+        opt_cs.push_back(1000);
+    }
+    if (opt_outside.empty()) {
+        opt_outside.push_back(0);
+        opt_outside.push_back(1000);
+    }
+    double ticks_per_ns = tsc_per_ns();
+
+    printf("Lock Contention, %.2f s per run, %zu cpus, read fraction %.2f, %.3f TSC ticks/ns\n", opt_duration,
+           opt_cpus.size(), opt_read_fraction, ticks_per_ns);
+    printf("%-16s %7s %6s %7s %10s %9s %7s %10s %10s %10s %5s\n", "Lock", "Threads", "CS", "Outside",
+           "Mops/s", "Max/Min", "Jain", "Hoff P50", "Hoff P99", "Hoff P99.9", "Check");
+    for (size_t tc = 0; tc < opt_threads.size(); tc++) {
+        for (size_t cs = 0; cs < opt_cs.size(); cs++) {
+            for (size_t out = 0; out < opt_outside.size(); out++) {
+                lock_config cfg;
+                cfg.threads = opt_threads[tc];
+                cfg.cs = opt_cs[cs];
+                cfg.outside = opt_outside[out];
+                cfg.duration = opt_duration;
+                cfg.read_fraction = opt_read_fraction;
+                cfg.cpus = opt_cpus;
+                for (size_t l = 0; l < opt_locks.size(); l++) {
+                    lock_result r = opt_locks[l]->run(cfg, ticks_per_ns);
+                    double total = 0, squares = 0;
+                    uint64_t lo = UINT64_MAX, hi = 0;
+                    for (size_t t = 0; t < r.acquisitions.size(); t++) {
+                        double a = (double) r.acquisitions[t];
+                        total += a;
+                        squares += a * a;
+                        lo = std::min(lo, r.acquisitions[t]);
+                        hi = std::max(hi, r.acquisitions[t]);
+                    }
+                    // jain's fairness index: 1 = perfectly even, 1/n = one thread got everything.
+                    double jain = squares > 0 ? total * total / (r.acquisitions.size() * squares) : 0;
+                    printf("%-16s %7d %6ld %7ld %10.3f", opt_locks[l]->name, cfg.threads, cfg.cs, cfg.outside,
+                           total / r.seconds / 1e6);
+                    if (lo > 0) {
+                        printf(" %9.2f", (double) hi / lo);
+                    } else {
+                        printf(" %9s", "starved");
+                    }
+                    printf(" %7.3f", jain);
+                    if (!r.handoff_ns.empty()) {
+                        printf(" %10.0f %10.0f %10.0f", percentile(r.handoff_ns, 0.5), percentile(r.handoff_ns, 0.99),
+                               percentile(r.handoff_ns, 0.999));
+                    } else {
+                        printf(" %10s %10s %10s", "-", "-", "-");
+                    }
+                    printf(" %5s\n", r.consistent ? "ok" : "BAD");
+                    fflush(stdout);
+                }
+                printf("------------------------\n");
+            }
+        }
+    }
+    return EXIT_SUCCESS;
+}
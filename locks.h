@@ -0,0 +1,194 @@
+#ifndef LOCKS_H
+#define LOCKS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <linux/futex.h> // for FUTEX_WAIT_PRIVATE, FUTEX_WAKE_PRIVATE
+#include <sys/syscall.h> // for SYS_futex
+#include <atomic>
+#include <mutex>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h> // for _mm_pause
+#endif
+
+// the locks lock_test compares, behind one interface: lock(node) /
+// unlock(node), plus lock_shared / unlock_shared for readers. node is the
+// caller's queue node; only the MCS lock uses it, the others ignore it. only
+// the reader-writer lock has a real shared mode, the rest take readers
+// exclusively.
+
+static inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#endif
+}
+
+// one per thread, on its own line so spinning on it stays local.
+struct alignas(64) lock_node {
+    std::atomic<lock_node*> next;
+    std::atomic<bool> locked;
+};
+
+class StdMutexLock {
+public:
+    void lock(lock_node&) { m_.lock(); }
+    void unlock(lock_node&) { m_.unlock(); }
+    void lock_shared(lock_node& n) { lock(n); }
+    void unlock_shared(lock_node& n) { unlock(n); }
+private:
+    std::mutex m_;
+};
+
+// glibc's adaptive mutex spins a bounded while before sleeping.
+class PthreadAdaptiveLock {
+public:
+    PthreadAdaptiveLock() {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+#ifdef PTHREAD_ADAPTIVE_MUTEX_INITIALIZER_NP
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ADAPTIVE_NP);
+#endif
+        pthread_mutex_init(&m_, &attr);
+        pthread_mutexattr_destroy(&attr);
+    }
+    ~PthreadAdaptiveLock() { pthread_mutex_destroy(&m_); }
+    void lock(lock_node&) { pthread_mutex_lock(&m_); }
+    void unlock(lock_node&) { pthread_mutex_unlock(&m_); }
+    void lock_shared(lock_node& n) { lock(n); }
+    void unlock_shared(lock_node& n) { unlock(n); }
+private:
+    pthread_mutex_t m_;
+};
+
+// drepper's "futexes are tricky" mutex: 0 free, 1 held, 2 held with
+// (possible) sleepers, so an uncontended unlock makes no system call.
+class FutexLock {
+public:
+    FutexLock() : state_(0) {}
+    void lock(lock_node&) {
+        int c = 0;
+        if (state_.compare_exchange_strong(c, 1, std::memory_order_acquire)) {
+            return;
+        }
+        if (c != 2) {
+            c = state_.exchange(2, std::memory_order_acquire);
+        }
+        while (c != 0) {
+            syscall(SYS_futex, (int*) &state_, FUTEX_WAIT_PRIVATE, 2, nullptr, nullptr, 0);
+            c = state_.exchange(2, std::memory_order_acquire);
+        }
+    }
+    void unlock(lock_node&) {
+        if (state_.fetch_sub(1, std::memory_order_release) != 1) {
+            state_.store(0, std::memory_order_release);
+            syscall(SYS_futex, (int*) &state_, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+        }
+    }
+    void lock_shared(lock_node& n) { lock(n); }
+    void unlock_shared(lock_node& n) { unlock(n); }
+private:
+    std::atomic<int> state_;
+};
+
+// test-and-test-and-set: spin on a plain load so waiters share the line
+// until it is released, and only then try the exchange.
+class TtasSpinLock {
+public:
+    TtasSpinLock() : held_(false) {}
+    void lock(lock_node&) {
+        for (;;) {
+            if (!held_.exchange(true, std::memory_order_acquire)) {
+                return;
+            }
+            while (held_.load(std::memory_order_relaxed)) {
+                cpu_relax();
+            }
+        }
+    }
+    void unlock(lock_node&) { held_.store(false, std::memory_order_release); }
+    void lock_shared(lock_node& n) { lock(n); }
+    void unlock_shared(lock_node& n) { unlock(n); }
+private:
+    std::atomic<bool> held_;
+};
+
+// fifo: take a ticket, wait until it is served.
+class TicketLock {
+public:
+    TicketLock() : next_(0), serving_(0) {}
+    void lock(lock_node&) {
+        unsigned int ticket = next_.fetch_add(1, std::memory_order_relaxed);
+        while (serving_.load(std::memory_order_acquire) != ticket) {
+            cpu_relax();
+        }
+    }
+    void unlock(lock_node&) {
+        serving_.store(serving_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+    void lock_shared(lock_node& n) { lock(n); }
+    void unlock_shared(lock_node& n) { unlock(n); }
+private:
+    std::atomic<unsigned int> next_;
+    alignas(64) std::atomic<unsigned int> serving_;
+};
+
+// mellor-crummey / scott queue lock: fifo, and each waiter spins on its own
+// node, so a release moves one line to one waiter instead of all of them.
+class McsLock {
+public:
+    McsLock() : tail_(nullptr) {}
+    void lock(lock_node& node) {
+        node.next.store(nullptr, std::memory_order_relaxed);
+        node.locked.store(true, std::memory_order_relaxed);
+        lock_node* prev = tail_.exchange(&node, std::memory_order_acq_rel);
+        if (prev == nullptr) {
+            return;
+        }
+        prev->next.store(&node, std::memory_order_release);
+        while (node.locked.load(std::memory_order_acquire)) {
+            cpu_relax();
+        }
+    }
+    void unlock(lock_node& node) {
+        lock_node* next = node.next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            lock_node* expected = &node;
+            if (tail_.compare_exchange_strong(expected, nullptr, std::memory_order_release)) {
+                return;
+            }
+            // a successor is between its exchange and linking itself in.
+            while ((next = node.next.load(std::memory_order_acquire)) == nullptr) {
+                cpu_relax();
+            }
+        }
+        next->locked.store(false, std::memory_order_release);
+    }
+    void lock_shared(lock_node& n) { lock(n); }
+    void unlock_shared(lock_node& n) { unlock(n); }
+private:
+    std::atomic<lock_node*> tail_;
+};
+
+// pthread reader-writer lock, writer preferring so a steady stream of
+// readers cannot starve the writers.
+class RwLock {
+public:
+    RwLock() {
+        pthread_rwlockattr_t attr;
+        pthread_rwlockattr_init(&attr);
+        pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+        pthread_rwlock_init(&rw_, &attr);
+        pthread_rwlockattr_destroy(&attr);
+    }
+    ~RwLock() { pthread_rwlock_destroy(&rw_); }
+    void lock(lock_node&) { pthread_rwlock_wrlock(&rw_); }
+    void unlock(lock_node&) { pthread_rwlock_unlock(&rw_); }
+    void lock_shared(lock_node&) { pthread_rwlock_rdlock(&rw_); }
+    void unlock_shared(lock_node&) { pthread_rwlock_unlock(&rw_); }
+private:
+    pthread_rwlock_t rw_;
+};
+
+#endif // LOCKS_H
@@ -0,0 +1,249 @@
+#ifndef MEM_ACCESS_H
+#define MEM_ACCESS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h> // for cpu_set_t and other scheduling things.
+#include <time.h> // for clock_gettime
+#include <cstdint> // for uint64_t
+#include <cinttypes> // for PRIu64
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "perf_counter_set.h"
+#include "access_pattern.h"
+
+// fixed point 1.0 for the store/load split in do_mem_access.
+#define WRITE_ONE (1ULL << 32)
+
+// walk one window params.locality times. stores are spread evenly with a
+// fixed point accumulator, so the default 1/8 writes lines 0, 8, 16, ...
+// exactly like the old i % 8 test, without a division or a table load.
+__attribute__((always_inline))
+static inline void touch_window(char* p, long ws_base, const access_params& params) {
+    long window = params.window_lines;
+    long stride = params.line_stride;
+    uint64_t write_step = (uint64_t) (params.write_fraction * WRITE_ONE);
+    if (write_step > WRITE_ONE) {
+        write_step = WRITE_ONE;
+    }
+    uint64_t write_start = write_step ? WRITE_ONE - write_step : 0;
+    for (int locality = 0; locality < params.locality; locality++) {
+        volatile char *a;
+        char c;
+        uint64_t acc = write_start;
+        for (long i = 0; i < window; i++) {
+            // Working set of window cache lines, 32KB by default
+            a = p + (ws_base + i * stride) * CACHE_LINE_SIZE;
+            acc += write_step;
+            if (acc >= WRITE_ONE) {
+                acc -= WRITE_ONE;
+                *a = 1;
+            } else {
+                c = *a;
+                (void) c;
+            }
+        }
+    }
+}
+
+// p points to a region that is 1GB (ideally). the pattern picks where each
+// window starts; params set the window, the passes over it and the share of
+// stores. this generates window starts as it goes, so the rng runs inside
+// whatever is being measured.
+static inline void do_mem_access(char* p, AccessPattern& pattern, const access_params& params) {
+    for (long outer = 0; outer < params.iterations; ++outer) {
+        touch_window(p, pattern.next_base(), params);
+    }
+}
+
+// same walk over window starts computed ahead of time (see
+// precompute_bases), so only the stream read, one sequential load per
+// window, is left in the measured region.
+static inline void do_mem_access(char* p, const long* bases, const access_params& params) {
+    for (long outer = 0; outer < params.iterations; ++outer) {
+        touch_window(p, bases[outer], params);
+    }
+}
+
+// every window start for one walk, generated before the counters are on.
+static inline std::vector<long> precompute_bases(AccessPattern& pattern, const access_params& params) {
+    std::vector<long> bases(params.iterations);
+    pattern.fill(bases.data(), params.iterations);
+    return bases;
+}
+
+// run one walk the way params asks: from a precomputed stream or live.
+// the stream must already be filled when precompute is set.
+static inline void run_mem_access(char* p, AccessPattern& pattern, const std::vector<long>& bases,
+                                  const access_params& params) {
+    if (params.precompute) {
+        do_mem_access(p, bases.data(), params);
+    } else {
+        do_mem_access(p, pattern, params);
+    }
+}
+
+// cache lines touched by one do_mem_access call.
+static inline double mem_access_lines(const access_params& params) {
+    return (double) params.iterations * params.locality * params.window_lines;
+}
+
+static inline double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static inline int pin_to_cpu(int cpu_id) {
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(cpu_id, &mask);
+    return sched_setaffinity(0, sizeof(mask), &mask);
+}
+
+// cpus this process may run on, lowest first. call before pinning.
+static inline std::vector<int> available_cpus() {
+    std::vector<int> cpus;
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    if (sched_getaffinity(0, sizeof(mask), &mask) == -1) {
+        perror("Oh no. CPU Get Operation Failed.");
+        return cpus;
+    }
+    for (int c = 0; c < CPU_SETSIZE; c++) {
+        if (CPU_ISSET(c, &mask)) {
+            cpus.push_back(c);
+        }
+    }
+    return cpus;
+}
+
+// what one walker thread saw.
+struct thread_result {
+    int cpu;
+    double seconds;
+    bool counters_ok;
+    std::map<std::string, uint64_t> values;
+};
+
+static inline double miss_rate(uint64_t misses, uint64_t accesses) {
+    return accesses ? (double) misses / accesses : 0.0;
+}
+
+// run do_mem_access on nthreads threads, thread t pinned to cpus[t]. with
+// shared set every thread walks the whole region, otherwise each walks its
+// own size / nthreads slice. every thread builds its own pattern, all are
+// released together once their counters are open, and each thread counts
+// only itself, on events (MEM_ACCESS_EVENTS when empty). an unknown
+// pattern returns no results.
+static inline std::vector<thread_result> run_mem_access_threads(char* p, long size, int nthreads,
+                                                         const std::vector<int>& cpus, bool shared,
+                                                         const char* pattern_name, const access_params& params,
+                                                         const std::vector<perf_event_spec>& events) {
+    long slice = shared ? size : (size / nthreads) & ~((long) CACHE_LINE_SIZE - 1);
+    if (!make_access_pattern(pattern_name, slice, params)) {
+        return std::vector<thread_result>();
+    }
+    std::vector<thread_result> results(nthreads);
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nthreads; t++) {
+        threads.push_back(std::thread([&, t]() {
+            thread_result& res = results[t];
+            res.cpu = cpus[t % cpus.size()];
+            if (pin_to_cpu(res.cpu) == -1) {
+                perror("Oh no. CPU Set Operation Failed.");
+            }
+            seed_thread_rng(t);
+            char* base = shared ? p : p + t * slice;
+            std::unique_ptr<AccessPattern> pattern = make_access_pattern(pattern_name, slice, params);
+            std::vector<long> bases;
+            if (params.precompute) {
+                bases = precompute_bases(*pattern, params);
+            }
+
+            PerfCounterSet counters;
+            if (events.empty()) {
+                counters.add(MEM_ACCESS_EVENTS, NUM_MEM_ACCESS_EVENTS);
+            } else {
+                counters.add(events.data(), events.size());
+            }
+            res.counters_ok = counters.open();
+
+            ready++;
+            while (!go.load(std::memory_order_acquire)) {
+            }
+
+            counters.reset();
+            counters.enable();
+            double start = now_seconds();
+            run_mem_access(base, *pattern, bases, params);
+            res.seconds = now_seconds() - start;
+            counters.disable();
+            if (res.counters_ok) {
+                res.values = counters.read();
+            }
+        }));
+    }
+    while (ready.load() < nthreads) {
+    }
+    go.store(true, std::memory_order_release);
+    for (size_t t = 0; t < threads.size(); t++) {
+        threads[t].join();
+    }
+    return results;
+}
+
+// sweep 1..cpus.size() threads and report aggregate throughput plus the
+// per-thread L1D and DTLB miss rates at each thread count.
+static inline int mem_access_thread_sweep(char* p, long size, const std::vector<int>& cpus, bool shared,
+                                          const char* pattern_name, const access_params& params,
+                                          const std::vector<perf_event_spec>& events) {
+    if (cpus.empty()) {
+        printf("No CPUs available for thread sweep.\n");
+        return EXIT_FAILURE;
+    }
+    // every access touches one cache line.
+    double lines_per_thread = mem_access_lines(params);
+    printf("Thread Sweep, %s region, %s pattern, 1..%zu threads\n", shared ? "shared" : "private slice",
+           pattern_name, cpus.size());
+    printf("------------------------\n");
+    for (size_t n = 1; n <= cpus.size(); n++) {
+        std::vector<thread_result> results = run_mem_access_threads(p, size, (int) n, cpus, shared,
+                                                                    pattern_name, params, events);
+        if (results.empty()) {
+            return EXIT_FAILURE;
+        }
+        double slowest = 0;
+        for (size_t t = 0; t < results.size(); t++) {
+            if (results[t].seconds > slowest) {
+                slowest = results[t].seconds;
+            }
+        }
+        double lines = lines_per_thread * n;
+        printf("Threads: %zu, Aggregate: %.3f Glines/s (%.2f GB/s touched), Wall: %.3f s\n",
+               n, lines / slowest / 1e9, lines * CACHE_LINE_SIZE / slowest / 1e9, slowest);
+        for (size_t t = 0; t < results.size(); t++) {
+            const thread_result& res = results[t];
+            const std::map<std::string, uint64_t>& v = res.values;
+            double l1d = miss_rate(counter_value(v, "L1D Read Misses") + counter_value(v, "L1D Write Misses"),
+                                   counter_value(v, "L1D Read Accesses") + counter_value(v, "L1D Write Accesses"));
+            double dtlb = miss_rate(counter_value(v, "DTLB Load Misses") + counter_value(v, "DTLB Store Misses"),
+                                    counter_value(v, "DTLB Load Accesses") + counter_value(v, "DTLB Store Accesses"));
+            printf("  Thread %zu (CPU %d): %.3f s, %.3f Glines/s", t, res.cpu, res.seconds,
+                   lines_per_thread / res.seconds / 1e9);
+            if (res.counters_ok) {
+                printf(", L1D Miss Rate: %.4f, DTLB Miss Rate: %.4f\n", l1d, dtlb);
+            } else {
+                printf(", counters unavailable\n");
+            }
+        }
+        printf("------------------------\n");
+    }
+    return EXIT_SUCCESS;
+}
+
+#endif // MEM_ACCESS_H
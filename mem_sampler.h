@@ -0,0 +1,422 @@
+#ifndef MEM_SAMPLER_H
+#define MEM_SAMPLER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <cstdint> // for uint64_t
+#include <algorithm> // for std::sort
+#include <atomic>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "perf_counter_set.h"
+#include "mem_access.h"
+
+// data pages in the sampling ring (a power of two), 2 MiB with 4 KiB pages.
+#define SAMPLE_RING_PAGES 512
+#define SAMPLE_PAGE_SIZE 4096
+
+// the probe streams this many bytes a few times, sampling every
+// SAMPLE_PROBE_PERIOD events, so any working source yields samples.
+#define SAMPLE_PROBE_BYTES (4 * 1024 * 1024)
+#define SAMPLE_PROBE_PERIOD 1009
+
+// one decoded PERF_RECORD_SAMPLE.
+struct mem_sample {
+    uint64_t ip;
+    uint64_t addr;
+    uint64_t weight;    // load latency in cycles where the PMU reports it, else 0
+};
+
+// a sysfs PMU event such as cpu/events/mem-loads ("event=0xcd,umask=0x1,
+// ldlat=3") turned into attr fields using the PMU's format/ files
+// ("config:0-7", "config1:0-15").
+static inline bool pmu_event_attr(const char* pmu, const char* event, struct perf_event_attr& attr) {
+    char path[256];
+    snprintf(path, sizeof(path), "/sys/bus/event_source/devices/%s/type", pmu);
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        return false;
+    }
+    unsigned type = 0;
+    bool ok = fscanf(file, "%u", &type) == 1;
+    fclose(file);
+    if (!ok) {
+        return false;
+    }
+    attr.type = type;
+    if (event == nullptr) {
+        return true;
+    }
+    snprintf(path, sizeof(path), "/sys/bus/event_source/devices/%s/events/%s", pmu, event);
+    file = fopen(path, "r");
+    if (file == nullptr) {
+        return false;
+    }
+    char spec[256] = "";
+    ok = fgets(spec, sizeof(spec), file) != nullptr;
+    fclose(file);
+    if (!ok) {
+        return false;
+    }
+    char* save = nullptr;
+    for (char* term = strtok_r(spec, ",\n", &save); term != nullptr; term = strtok_r(nullptr, ",\n", &save)) {
+        char* eq = strchr(term, '=');
+        uint64_t value = eq ? strtoull(eq + 1, nullptr, 0) : 1;
+        if (eq) {
+            *eq = '\0';
+        }
+        snprintf(path, sizeof(path), "/sys/bus/event_source/devices/%s/format/%s", pmu, term);
+        file = fopen(path, "r");
+        if (file == nullptr) {
+            return false;
+        }
+        char format[128] = "";
+        ok = fgets(format, sizeof(format), file) != nullptr;
+        fclose(file);
+        char* colon = strchr(format, ':');
+        if (!ok || colon == nullptr) {
+            return false;
+        }
+        *colon = '\0';
+        __u64* field = strcmp(format, "config") == 0 ? &attr.config
+                        : strcmp(format, "config1") == 0 ? &attr.config1
+                        : strcmp(format, "config2") == 0 ? &attr.config2 : nullptr;
+        if (field == nullptr) {
+            return false;
+        }
+        // bit ranges like "0-7,32-35" are filled low bits first.
+        char* rsave = nullptr;
+        for (char* range = strtok_r(colon + 1, ",\n", &rsave); range != nullptr;
+             range = strtok_r(nullptr, ",\n", &rsave)) {
+            int lo = 0, hi = 0;
+            if (sscanf(range, "%d-%d", &lo, &hi) != 2) {
+                hi = lo = atoi(range);
+            }
+            int bits = hi - lo + 1;
+            uint64_t mask = bits >= 64 ? ~0ULL : ((1ULL << bits) - 1);
+            *field |= (value & mask) << lo;
+            value = bits >= 64 ? 0 : value >> bits;
+        }
+    }
+    return true;
+}
+
+// address sampling on the calling thread through a perf mmap ring. open()
+// tries the most precise source first:
+//   PEBS load latency (cpu/events/mem-loads), with weights
+//   AMD IBS op sampling
+//   L1D read misses, precise_ip 2 then 1
+//   software page faults (fault addresses only, no weights)
+// and a reader thread drains the ring while the workload runs. without
+// PEBS or IBS a hardware event reports addr 0, so each hardware source is
+// probed on a scratch buffer first and skipped unless it yields addresses.
+class MemSampler {
+public:
+    MemSampler() : fd_(-1), ring_(MAP_FAILED), sample_type_(0), lost_(0), running_(false) {}
+    ~MemSampler() { close_all(); }
+
+    bool open(uint64_t period) {
+        struct candidate {
+            const char* name;
+            const char* pmu;
+            const char* event;
+            uint32_t type;
+            uint64_t config;
+            int precise;
+        };
+        const uint64_t l1d_miss = hw_cache_config(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+                                                  PERF_COUNT_HW_CACHE_RESULT_MISS);
+        const candidate candidates[] = {
+            {"PEBS mem-loads", "cpu", "mem-loads", 0, 0, 2},
+            {"PEBS mem-loads", "cpu_core", "mem-loads", 0, 0, 2},
+            {"IBS op", "ibs_op", nullptr, 0, 0, 0},
+            {"L1D Read Misses (precise 2)", nullptr, nullptr, PERF_TYPE_HW_CACHE, l1d_miss, 2},
+            {"L1D Read Misses (precise 1)", nullptr, nullptr, PERF_TYPE_HW_CACHE, l1d_miss, 1},
+            {"Page Faults (every fault)", nullptr, nullptr, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, 0},
+        };
+        for (size_t c = 0; c < sizeof(candidates) / sizeof(candidates[0]); c++) {
+            const candidate& cand = candidates[c];
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            if (cand.pmu != nullptr) {
+                if (!pmu_event_attr(cand.pmu, cand.event, attr)) {
+                    continue;
+                }
+            } else {
+                attr.type = cand.type;
+                attr.config = cand.config;
+            }
+            // page faults are rare next to loads; sample every one.
+            bool hardware = cand.type != PERF_TYPE_SOFTWARE;
+            attr.sample_period = hardware ? std::min<uint64_t>(period, SAMPLE_PROBE_PERIOD) : 1;
+            attr.precise_ip = cand.precise;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.wakeup_events = 1;
+            // drop WEIGHT for sources that refuse it; software events
+            // accept it but always report 0.
+            uint64_t types[] = {
+                PERF_SAMPLE_IP | PERF_SAMPLE_ADDR | PERF_SAMPLE_WEIGHT,
+                PERF_SAMPLE_IP | PERF_SAMPLE_ADDR,
+            };
+            for (size_t t = cand.type == PERF_TYPE_SOFTWARE ? 1 : 0; t < 2 && fd_ == -1; t++) {
+                attr.sample_type = types[t];
+                fd_ = (int) perf_event_open(&attr, 0, -1, -1, 0);
+                if (fd_ != -1) {
+                    sample_type_ = types[t];
+                    source_ = cand.name;
+                }
+            }
+            if (fd_ == -1) {
+                continue;
+            }
+            if (!map_ring()) {
+                return false;
+            }
+            if (!hardware) {
+                break;
+            }
+            if (probe_addresses() && ioctl(fd_, PERF_EVENT_IOC_PERIOD, &period) == 0) {
+                break;
+            }
+            printf("%s gives no sample addresses here, skipped.\n", cand.name);
+            close_all();
+        }
+        if (fd_ == -1) {
+            perror("Oh no. No address sampling event could be opened.");
+            return false;
+        }
+        return true;
+    }
+
+    // which event the samples come from.
+    const std::string& source() const { return source_; }
+    bool has_weight() const { return sample_type_ & PERF_SAMPLE_WEIGHT; }
+
+    // start sampling and the reader thread, pinned to cpu so it stays off
+    // the measured one. cpu < 0 leaves the thread unpinned.
+    void start(int cpu) {
+        samples_.clear();
+        lost_ = 0;
+        running_ = true;
+        reader_ = std::thread([this, cpu] {
+            if (cpu >= 0) {
+                pin_to_cpu(cpu);
+            }
+            while (running_.load(std::memory_order_relaxed)) {
+                drain();
+                usleep(1000);
+            }
+        });
+        ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    void stop() {
+        ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+        running_ = false;
+        if (reader_.joinable()) {
+            reader_.join();
+        }
+        drain();
+    }
+
+    const std::vector<mem_sample>& samples() const { return samples_; }
+    uint64_t lost() const { return lost_; }
+
+    void close_all() {
+        if (ring_ != MAP_FAILED) {
+            munmap(ring_, (SAMPLE_RING_PAGES + 1) * SAMPLE_PAGE_SIZE);
+            ring_ = MAP_FAILED;
+        }
+        if (fd_ != -1) {
+            close(fd_);
+            fd_ = -1;
+        }
+    }
+
+private:
+    bool map_ring() {
+        size_t len = (SAMPLE_RING_PAGES + 1) * SAMPLE_PAGE_SIZE;
+        ring_ = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (ring_ == MAP_FAILED) {
+            perror("Oh no. Perf Ring Mapping Failed.");
+            close(fd_);
+            fd_ = -1;
+            return false;
+        }
+        return true;
+    }
+
+    // stream a scratch buffer with the event enabled; true if any sample
+    // carried a data address.
+    bool probe_addresses() {
+        std::vector<char> scratch(SAMPLE_PROBE_BYTES, 1);
+        volatile uint64_t sum = 0;
+        ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+        for (int pass = 0; pass < 4; pass++) {
+            for (size_t i = 0; i < scratch.size(); i += CACHE_LINE_SIZE) {
+                sum += *(volatile char*) &scratch[i];
+            }
+        }
+        ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+        (void) sum;
+        samples_.clear();
+        drain();
+        bool found = false;
+        for (size_t i = 0; i < samples_.size() && !found; i++) {
+            found = samples_[i].addr != 0;
+        }
+        samples_.clear();
+        lost_ = 0;
+        return found;
+    }
+
+    // consume every record between data_tail and data_head. records can wrap
+    // the end of the ring, so each is copied out before decoding.
+    void drain() {
+        struct perf_event_mmap_page* meta = (struct perf_event_mmap_page*) ring_;
+        const uint8_t* data = (const uint8_t*) ring_ + SAMPLE_PAGE_SIZE;
+        const uint64_t size = (uint64_t) SAMPLE_RING_PAGES * SAMPLE_PAGE_SIZE;
+        uint64_t head = __atomic_load_n(&meta->data_head, __ATOMIC_ACQUIRE);
+        uint64_t tail = meta->data_tail;
+        uint8_t record[512];
+        while (tail < head) {
+            struct perf_event_header hdr;
+            copy_out(data, size, tail, &hdr, sizeof(hdr));
+            if (hdr.size < sizeof(hdr) || hdr.size > sizeof(record)) {
+                tail = head;
+                break;
+            }
+            copy_out(data, size, tail, record, hdr.size);
+            const uint64_t* body = (const uint64_t*) (record + sizeof(hdr));
+            if (hdr.type == PERF_RECORD_SAMPLE) {
+                // fields appear in PERF_SAMPLE_* bit order: IP, ADDR, WEIGHT.
+                mem_sample s;
+                s.ip = body[0];
+                s.addr = body[1];
+                s.weight = (sample_type_ & PERF_SAMPLE_WEIGHT) ? body[2] : 0;
+                samples_.push_back(s);
+            } else if (hdr.type == PERF_RECORD_LOST) {
+                lost_ += body[1];
+            }
+            tail += hdr.size;
+        }
+        __atomic_store_n(&meta->data_tail, tail, __ATOMIC_RELEASE);
+    }
+
+    static void copy_out(const uint8_t* data, uint64_t size, uint64_t pos, void* out, size_t n) {
+        uint64_t off = pos & (size - 1);
+        size_t first = (size_t) (size - off) < n ? (size_t) (size - off) : n;
+        memcpy(out, data + off, first);
+        memcpy((uint8_t*) out + first, data, n - first);
+    }
+
+    int fd_;
+    void* ring_;
+    uint64_t sample_type_;
+    std::string source_;
+    std::vector<mem_sample> samples_;
+    uint64_t lost_;
+    std::atomic<bool> running_;
+    std::thread reader_;
+};
+
+// samples and summed weight for one page or cache line.
+struct heat_cell {
+    uint64_t samples;
+    uint64_t weight;
+};
+
+// fold the samples that land in [p, p + size) into per-page and
+// per-cache-line heat, write both as csv (index, byte offset, samples,
+// weight, mean weight) and print a coarse strip of the region plus the
+// hottest pages.
+static inline int write_heatmaps(const std::vector<mem_sample>& samples, const char* p, size_t size,
+                                 const char* prefix, bool weighted) {
+    uintptr_t start = (uintptr_t) p;
+    std::unordered_map<uint64_t, heat_cell> pages, lines;
+    uint64_t in_region = 0;
+    for (size_t i = 0; i < samples.size(); i++) {
+        uintptr_t a = (uintptr_t) samples[i].addr;
+        if (a < start || a >= start + size) {
+            continue;
+        }
+        in_region++;
+        uint64_t off = a - start;
+        heat_cell& page = pages[off / SAMPLE_PAGE_SIZE];
+        page.samples++;
+        page.weight += samples[i].weight;
+        heat_cell& line = lines[off / CACHE_LINE_SIZE];
+        line.samples++;
+        line.weight += samples[i].weight;
+    }
+    printf("Samples: %zu total, %" PRIu64 " in region, %zu pages and %zu lines hit\n", samples.size(),
+           in_region, pages.size(), lines.size());
+
+    const char* kinds[] = { "pages", "lines" };
+    const std::unordered_map<uint64_t, heat_cell>* maps[] = { &pages, &lines };
+    const uint64_t cell_bytes[] = { SAMPLE_PAGE_SIZE, CACHE_LINE_SIZE };
+    std::vector<std::pair<uint64_t, heat_cell> > sorted;
+    for (int k = 0; k < 2; k++) {
+        sorted.assign(maps[k]->begin(), maps[k]->end());
+        std::sort(sorted.begin(), sorted.end(),
+                  [](const std::pair<uint64_t, heat_cell>& a, const std::pair<uint64_t, heat_cell>& b) {
+                      return a.first < b.first;
+                  });
+        std::string path = std::string(prefix) + "_" + kinds[k] + ".csv";
+        FILE* file = fopen(path.c_str(), "w");
+        if (file == nullptr) {
+            perror("Error in system call fopen");
+            return EXIT_FAILURE;
+        }
+        fprintf(file, "index,offset,samples,weight,mean_weight\n");
+        for (size_t i = 0; i < sorted.size(); i++) {
+            const heat_cell& c = sorted[i].second;
+            fprintf(file, "%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.1f\n", sorted[i].first,
+                    sorted[i].first * cell_bytes[k], c.samples, c.weight, (double) c.weight / c.samples);
+        }
+        fclose(file);
+        printf("Wrote %zu %s to %s.\n", sorted.size(), kinds[k], path.c_str());
+    }
+
+    // 64 buckets across the region, shaded by share of the hottest bucket.
+    const int buckets = 64;
+    std::vector<double> heat(buckets, 0.0);
+    for (std::unordered_map<uint64_t, heat_cell>::const_iterator it = pages.begin(); it != pages.end(); ++it) {
+        size_t b = (size_t) ((it->first * SAMPLE_PAGE_SIZE) * buckets / size);
+        heat[b < (size_t) buckets ? b : buckets - 1] += weighted ? it->second.weight : it->second.samples;
+    }
+    double peak = *std::max_element(heat.begin(), heat.end());
+    const char* shades = " .:-=+*#%@";
+    printf("Region heat (%s, low -> high address): [", weighted ? "weight" : "samples");
+    for (int b = 0; b < buckets; b++) {
+        printf("%c", peak > 0 ? shades[(int) (heat[b] / peak * 9)] : ' ');
+    }
+    printf("]\n");
+
+    sorted.assign(pages.begin(), pages.end());
+    std::sort(sorted.begin(), sorted.end(),
+              [weighted](const std::pair<uint64_t, heat_cell>& a, const std::pair<uint64_t, heat_cell>& b) {
+                  return weighted ? a.second.weight > b.second.weight : a.second.samples > b.second.samples;
+              });
+    printf("%10s %12s %10s %12s\n", "Page", "Offset", "Samples", "Mean Weight");
+    for (size_t i = 0; i < sorted.size() && i < 10; i++) {
+        const heat_cell& c = sorted[i].second;
+        printf("%10" PRIu64 " %12" PRIu64 " %10" PRIu64 " %12.1f\n", sorted[i].first,
+               sorted[i].first * SAMPLE_PAGE_SIZE, c.samples, (double) c.weight / c.samples);
+    }
+    return EXIT_SUCCESS;
+}
+
+#endif // MEM_SAMPLER_H
@@ -0,0 +1,148 @@
+#ifndef PAGE_FAULT_PROFILE_H
+#define PAGE_FAULT_PROFILE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <cstdint> // for uint64_t
+#include <algorithm> // for std::sort
+#include <vector>
+
+#include "pointer_chase.h" // for read_tsc, tsc_per_ns
+#include "region.h"
+#include "trial_stats.h" // for percentile
+
+static const struct perf_event_spec PAGE_FAULT_EVENTS[] = {
+    {"Minor Faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MIN, false},
+    {"Major Faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MAJ, false},
+};
+
+static const size_t NUM_PAGE_FAULT_EVENTS = sizeof(PAGE_FAULT_EVENTS) / sizeof(PAGE_FAULT_EVENTS[0]);
+
+// minor / major fault counts from the perf counters when they opened,
+// otherwise from getrusage (which also sees faults taken inside the
+// kernel on our behalf, e.g. MAP_POPULATE).
+struct fault_counts {
+    uint64_t minor;
+    uint64_t major;
+};
+
+class FaultCounter {
+public:
+    FaultCounter() : ok_(false) {
+        counters_.add(PAGE_FAULT_EVENTS, NUM_PAGE_FAULT_EVENTS);
+        ok_ = counters_.open();
+        memset(&ru_, 0, sizeof(ru_));
+    }
+
+    bool perf() const { return ok_; }
+
+    void start() {
+        getrusage(RUSAGE_SELF, &ru_);
+        if (ok_) {
+            counters_.reset();
+            counters_.enable();
+        }
+    }
+
+    fault_counts stop() {
+        fault_counts c;
+        if (ok_) {
+            counters_.disable();
+            std::map<std::string, uint64_t> v = counters_.read();
+            c.minor = counter_value(v, "Minor Faults");
+            c.major = counter_value(v, "Major Faults");
+        } else {
+            struct rusage ru_2;
+            getrusage(RUSAGE_SELF, &ru_2);
+            c.minor = ru_2.ru_minflt - ru_.ru_minflt;
+            c.major = ru_2.ru_majflt - ru_.ru_majflt;
+        }
+        return c;
+    }
+
+private:
+    PerfCounterSet counters_;
+    bool ok_;
+    struct rusage ru_;
+};
+
+// time the allocation of one region, then the first write to each of its
+// pages, one rdtsc pair per page. prints one row: allocation time and
+// faults, touch time and faults, faults/s and ns/fault over the touch
+// pass, and percentiles of the per-page first-touch latency.
+static inline int profile_region_faults(const region_type& region, size_t size, FaultCounter& faults,
+                                        double ticks_per_ns) {
+    size_t page = sysconf(_SC_PAGE_SIZE);
+    size_t pages = size / page;
+    if (pages == 0) {
+        printf("%-34s smaller than one %zu byte page, skipped\n", region.name, page);
+        return EXIT_FAILURE;
+    }
+    std::vector<uint32_t> ticks(pages);
+
+    faults.start();
+    double t0 = now_seconds();
+    char* p = region.allocate(size);
+    double alloc_s = now_seconds() - t0;
+    fault_counts alloc = faults.stop();
+    if (p == nullptr) {
+        printf("%-34s allocation failed, skipped\n", region.name);
+        return EXIT_FAILURE;
+    }
+
+    faults.start();
+    t0 = now_seconds();
+    for (size_t i = 0; i < pages; i++) {
+        volatile char* a = p + i * page;
+        uint64_t c0 = read_tsc();
+        *a = 1;
+        uint64_t c1 = read_tsc();
+        ticks[i] = (uint32_t) std::min<uint64_t>(c1 - c0, UINT32_MAX);
+    }
+    double touch_s = now_seconds() - t0;
+    fault_counts touch = faults.stop();
+    region.release(p, size);
+
+    std::vector<double> ns(pages);
+    for (size_t i = 0; i < pages; i++) {
+        ns[i] = ticks[i] / ticks_per_ns;
+    }
+    std::sort(ns.begin(), ns.end());
+    uint64_t touch_faults = touch.minor + touch.major;
+    printf("%-34s %9.1f %8" PRIu64 " %9.1f %8" PRIu64 " %6" PRIu64 " %11.0f %9.0f %8.0f %8.0f %8.0f %8.0f %9.0f\n",
+           region.name, alloc_s * 1e3, alloc.minor + alloc.major, touch_s * 1e3, touch.minor, touch.major,
+           touch_s > 0 ? touch_faults / touch_s : 0.0, touch_faults ? touch_s * 1e9 / touch_faults : 0.0,
+           percentile(ns, 0.5), percentile(ns, 0.9), percentile(ns, 0.99), percentile(ns, 0.999), ns.back());
+    fflush(stdout);
+    return EXIT_SUCCESS;
+}
+
+// run the profile for every region type, or just the one given. a region
+// that cannot be allocated (e.g. hugetlb with no pages reserved) is
+// reported and skipped.
+static inline int page_fault_profile(size_t size, const region_type* only) {
+    if (size < REGION_PAGE_SIZE) {
+        printf("The fault profile needs at least one page (%d bytes) per region.\n", REGION_PAGE_SIZE);
+        return EXIT_FAILURE;
+    }
+    FaultCounter faults;
+    double ticks_per_ns = tsc_per_ns();
+    printf("Page Fault Profile, %zu MiB per region, faults from %s, %.3f TSC ticks/ns\n", size >> 20,
+           faults.perf() ? "perf software events" : "getrusage", ticks_per_ns);
+    printf("%-34s %9s %8s %9s %8s %6s %11s %9s %8s %8s %8s %8s %9s\n", "Region", "Alloc ms", "Alloc F",
+           "Touch ms", "Minor", "Major", "Faults/s", "ns/Fault", "P50 ns", "P90 ns", "P99 ns", "P99.9 ns",
+           "Max ns");
+    for (size_t r = 0; r < NUM_REGION_TYPES; r++) {
+        if (only != nullptr && only != &REGION_TYPES[r]) {
+            continue;
+        }
+        profile_region_faults(REGION_TYPES[r], size, faults, ticks_per_ns);
+    }
+    printf("------------------------\n");
+    return EXIT_SUCCESS;
+}
+
+#endif // PAGE_FAULT_PROFILE_H
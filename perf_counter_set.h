@@ -0,0 +1,321 @@
+#ifndef PERF_COUNTER_SET_H
+#define PERF_COUNTER_SET_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h> // for ioctl
+#include <unistd.h>
+#include <cstring> // for memset
+#include <strings.h> // for strcasecmp
+#include <cstdint> // for uint64_t
+#include <map>
+#include <string>
+#include <vector>
+
+// linux wrapper function to open a perf event.
+static inline long perf_event_open(struct perf_event_attr *hw_event, pid_t pid,
+                             int cpu, int group_fd, unsigned long flags) {
+	int ret;
+	ret = syscall(SYS_perf_event_open, hw_event, pid, cpu,
+                         group_fd, flags);
+	return ret;
+}
+
+// to calculate the appropriate config, we use this formula:
+// config = (perf_hw_cache_id) | (perf_hw_cache_op_id << 8) | (perf_hw_cache_op_result_id << 16);
+static inline uint64_t hw_cache_config(uint64_t cache, uint64_t op, uint64_t result) {
+    return cache | (op << 8) | (result << 16);
+}
+
+// one counter to open. optional events are skipped (with a message) when the
+// PMU does not support them instead of failing the whole set.
+struct perf_event_spec {
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+    bool optional;
+};
+
+//   L1-dcache-load-misses                              [Hardware cache event]
+//   L1-dcache-loads                                    [Hardware cache event]
+//   L1-dcache-store-misses                             [Hardware cache event]
+//   L1-dcache-stores                                   [Hardware cache event]
+//   L1-dcache-prefetch-misses                          [Hardware cache event]
+//   L1-dcache-prefetches                               [Hardware cache event]
+//   dTLB-load-misses                                   [Hardware cache event]
+//   dTLB-loads                                         [Hardware cache event]
+//   dTLB-store-misses                                  [Hardware cache event]
+//   dTLB-stores                                        [Hardware cache event]
+static const struct perf_event_spec MEM_ACCESS_EVENTS[] = {
+    { "L1D Read Misses", PERF_TYPE_HW_CACHE,
+      hw_cache_config(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS), false },
+    { "L1D Read Accesses", PERF_TYPE_HW_CACHE,
+      hw_cache_config(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_ACCESS), false },
+    { "L1D Write Misses", PERF_TYPE_HW_CACHE,
+      hw_cache_config(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_WRITE, PERF_COUNT_HW_CACHE_RESULT_MISS), false },
+    { "L1D Write Accesses", PERF_TYPE_HW_CACHE,
+      hw_cache_config(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_WRITE, PERF_COUNT_HW_CACHE_RESULT_ACCESS), false },
+    { "L1D Prefetch Misses", PERF_TYPE_HW_CACHE,
+      hw_cache_config(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_PREFETCH, PERF_COUNT_HW_CACHE_RESULT_MISS), false },
+    // most intel cores do not expose this one.
+    { "L1D Prefetch Accesses", PERF_TYPE_HW_CACHE,
+      hw_cache_config(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_PREFETCH, PERF_COUNT_HW_CACHE_RESULT_ACCESS), true },
+    { "DTLB Load Misses", PERF_TYPE_HW_CACHE,
+      hw_cache_config(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS), false },
+    { "DTLB Load Accesses", PERF_TYPE_HW_CACHE,
+      hw_cache_config(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_ACCESS), false },
+    { "DTLB Store Misses", PERF_TYPE_HW_CACHE,
+      hw_cache_config(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_WRITE, PERF_COUNT_HW_CACHE_RESULT_MISS), false },
+    { "DTLB Store Accesses", PERF_TYPE_HW_CACHE,
+      hw_cache_config(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_WRITE, PERF_COUNT_HW_CACHE_RESULT_ACCESS), false },
+};
+static const size_t NUM_MEM_ACCESS_EVENTS = sizeof(MEM_ACCESS_EVENTS) / sizeof(MEM_ACCESS_EVENTS[0]);
+
+// look an event up by name (case insensitive), nullptr if there is none.
+static inline const perf_event_spec* find_mem_access_event(const char* name) {
+    for (size_t i = 0; i < NUM_MEM_ACCESS_EVENTS; i++) {
+        if (strcasecmp(MEM_ACCESS_EVENTS[i].name, name) == 0) {
+            return &MEM_ACCESS_EVENTS[i];
+        }
+    }
+    return nullptr;
+}
+
+// a set of counters on the calling thread, packed into as few groups as the
+// PMU will accept. each event is first tried as a member of the current group;
+// when the kernel rejects it (the group no longer fits) it becomes the leader
+// of a new group. every group leader is opened disabled and all groups are
+// reset/enabled/disabled together.
+//
+// when there are more groups than the PMU can run at once the kernel
+// multiplexes them, so every read also returns time_enabled/time_running.
+// values are scaled by enabled/running and the ratio running/enabled is kept
+// per group as its coverage (1.0 = counted the whole time). with rotation on,
+// only one group is live per trial so it always gets full coverage.
+class PerfCounterSet {
+public:
+    // max_group_size caps the events per group (0 = as many as the PMU takes).
+    explicit PerfCounterSet(size_t max_group_size = 0)
+        : max_group_size_(max_group_size), active_group_(-1) {}
+
+    ~PerfCounterSet() { close_all(); }
+
+    PerfCounterSet(const PerfCounterSet&) = delete;
+    PerfCounterSet& operator=(const PerfCounterSet&) = delete;
+
+    void add(const struct perf_event_spec& spec) { specs_.push_back(spec); }
+
+    void add(const struct perf_event_spec* specs, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            add(specs[i]);
+        }
+    }
+
+    // open every added event. returns false if a required event failed.
+    bool open() {
+        for (size_t i = 0; i < specs_.size(); i++) {
+            const struct perf_event_spec& spec = specs_[i];
+            bool have_group = !groups_.empty() &&
+                (max_group_size_ == 0 || groups_.back().members.size() < max_group_size_);
+            int fd = -1;
+            if (have_group) {
+                fd = open_event(spec, groups_.back().members[0].fd);
+            }
+            if (fd == -1) {
+                // start a new group with this event as its leader.
+                fd = open_event(spec, -1);
+                if (fd == -1) {
+                    if (spec.optional) {
+                        printf("Perf Event Unsupported, Skipping. %s.\n", spec.name);
+                        continue;
+                    }
+                    fprintf(stderr, "Perf Event Open Failed. %s. ", spec.name);
+                    perror("");
+                    return false;
+                }
+                groups_.push_back(group());
+            }
+            struct member m;
+            m.fd = fd;
+            m.raw = 0;
+            m.name = spec.name;
+            if (ioctl(fd, PERF_EVENT_IOC_ID, &m.id) == -1) {
+                perror("Perf Event ID Failed.");
+                ::close(fd);
+                // a leader opened just now leaves an empty group behind.
+                if (groups_.back().members.empty()) {
+                    groups_.pop_back();
+                }
+                return false;
+            }
+            groups_.back().members.push_back(m);
+            names_.push_back(spec.name);
+        }
+        return true;
+    }
+
+    // only measure group (trial % num_groups) from now on. lets a run of
+    // trials cover every group once without any multiplexing.
+    void rotate(size_t trial) {
+        if (!groups_.empty()) {
+            active_group_ = (int) (trial % groups_.size());
+        }
+    }
+
+    // go back to measuring all groups at once.
+    void rotate_off() { active_group_ = -1; }
+
+    // group being measured under rotation, -1 when all groups are live.
+    int active_group() const { return active_group_; }
+
+    // reset is per-leader, but it happens before enable so it adds no skew.
+    void reset() {
+        for (size_t g = 0; g < groups_.size(); g++) {
+            ioctl(groups_[g].members[0].fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        }
+    }
+
+    // per-leader ioctls, so only this set's groups start and stop; a
+    // thread-wide prctl would also flip the fault counters, samplers and
+    // time series counters the thread owns. under rotation only the active
+    // leader is touched.
+    void enable() { toggle(PERF_EVENT_IOC_ENABLE); }
+
+    void disable() { toggle(PERF_EVENT_IOC_DISABLE); }
+
+    // read all groups (or just the active one under rotation) and return
+    // event name -> value scaled for multiplexing. a group that never got on
+    // the PMU (time_running == 0) reports 0 and coverage 0.
+    std::map<std::string, uint64_t> read() {
+        std::map<std::string, uint64_t> values;
+        uint64_t buf[512];
+        for (size_t g = 0; g < groups_.size(); g++) {
+            group& grp = groups_[g];
+            if (active_group_ >= 0 && (int) g != active_group_) {
+                continue;
+            }
+            if (::read(grp.members[0].fd, buf, sizeof(buf)) == -1) {
+                perror("Perf Event Read Failed.");
+                continue;
+            }
+            // layout: nr, time_enabled, time_running, then { value, id } per member.
+            uint64_t nr = buf[0];
+            grp.time_enabled = buf[1];
+            grp.time_running = buf[2];
+            grp.coverage = grp.time_enabled ? (double) grp.time_running / grp.time_enabled : 0.0;
+            for (uint64_t i = 0; i < nr; i++) {
+                uint64_t value = buf[3 + i * 2];
+                uint64_t id = buf[4 + i * 2];
+                uint64_t scaled = 0;
+                if (grp.time_running != 0) {
+                    scaled = (uint64_t) ((double) value * grp.time_enabled / grp.time_running);
+                }
+                for (size_t k = 0; k < grp.members.size(); k++) {
+                    if (grp.members[k].id == id) {
+                        grp.members[k].raw = value;
+                        values[grp.members[k].name] = scaled;
+                    }
+                }
+            }
+        }
+        return values;
+    }
+
+    // coverage (time_running / time_enabled) of group g as of the last read().
+    double coverage(size_t g) const { return groups_[g].coverage; }
+
+    // unscaled value of an event as of the last read(), 0 if not read.
+    uint64_t raw(const std::string& name) const {
+        for (size_t g = 0; g < groups_.size(); g++) {
+            for (size_t k = 0; k < groups_[g].members.size(); k++) {
+                if (groups_[g].members[k].name == name) {
+                    return groups_[g].members[k].raw;
+                }
+            }
+        }
+        return 0;
+    }
+
+    // "name + name + ..." label for group g, for reporting coverage.
+    std::string group_label(size_t g) const {
+        std::string label;
+        for (size_t k = 0; k < groups_[g].members.size(); k++) {
+            if (k > 0) {
+                label += " + ";
+            }
+            label += groups_[g].members[k].name;
+        }
+        return label;
+    }
+
+    // names of the opened events, in the order they were added.
+    const std::vector<std::string>& names() const { return names_; }
+
+    size_t num_groups() const { return groups_.size(); }
+
+    void close_all() {
+        for (size_t g = 0; g < groups_.size(); g++) {
+            for (size_t k = 0; k < groups_[g].members.size(); k++) {
+                ::close(groups_[g].members[k].fd);
+            }
+        }
+        groups_.clear();
+        names_.clear();
+        active_group_ = -1;
+    }
+
+private:
+    struct member {
+        int fd;
+        uint64_t id;
+        uint64_t raw;
+        std::string name;
+    };
+
+    struct group {
+        group() : time_enabled(0), time_running(0), coverage(0.0) {}
+        std::vector<member> members;
+        uint64_t time_enabled;
+        uint64_t time_running;
+        double coverage;
+    };
+
+    void toggle(unsigned long request) {
+        for (size_t g = 0; g < groups_.size(); g++) {
+            if (active_group_ < 0 || (int) g == active_group_) {
+                ioctl(groups_[g].members[0].fd, request, PERF_IOC_FLAG_GROUP);
+            }
+        }
+    }
+
+    static int open_event(const struct perf_event_spec& spec, int group_fd) {
+        struct perf_event_attr pe;
+        memset(&pe, 0, sizeof(pe));
+        pe.type = spec.type;
+        pe.size = sizeof(pe);
+        pe.config = spec.config;
+        // only the leader is disabled, members follow it.
+        pe.disabled = (group_fd == -1) ? 1 : 0;
+        pe.exclude_kernel = 1;
+        pe.exclude_hv = 1;
+        pe.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID |
+                         PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return (int) perf_event_open(&pe, 0, -1, group_fd, 0);
+    }
+
+    size_t max_group_size_;
+    int active_group_;
+    std::vector<struct perf_event_spec> specs_;
+    std::vector<group> groups_;
+    std::vector<std::string> names_;
+};
+
+// value of a counter by name, 0 if it was skipped.
+static inline uint64_t counter_value(const std::map<std::string, uint64_t>& values, const char* name) {
+    std::map<std::string, uint64_t>::const_iterator it = values.find(name);
+    return it == values.end() ? 0 : it->second;
+}
+
+#endif // PERF_COUNTER_SET_H
@@ -0,0 +1,139 @@
+#ifndef POINTER_CHASE_H
+#define POINTER_CHASE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h> // for nanosleep
+#include <cstdint> // for uint64_t
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h> // for __rdtsc
+#endif
+
+#include "mem_access.h"
+
+// loads timed at every working set size, after one warm-up pass.
+#define POINTER_CHASE_LOADS (1 << 24)
+
+static const struct perf_event_spec CYCLES_EVENT = {
+    "Cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, true
+};
+
+static inline uint64_t read_tsc() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// TSC ticks per nanosecond, measured against CLOCK_MONOTONIC over ~50 ms.
+static inline double tsc_per_ns() {
+    struct timespec pause = {0, 50 * 1000 * 1000};
+    double t0 = now_seconds();
+    uint64_t c0 = read_tsc();
+    nanosleep(&pause, nullptr);
+    uint64_t c1 = read_tsc();
+    double t1 = now_seconds();
+    return (c1 - c0) / ((t1 - t0) * 1e9);
+}
+
+// link the first ws_bytes of p into one random cycle through every cache
+// line (sattolo's shuffle, so there is a single cycle and no short loops).
+// each line holds a pointer to the next, so every load depends on the one
+// before it and the prefetchers have nothing to predict.
+static inline void** build_pointer_chase(char* p, size_t ws_bytes) {
+    size_t lines = ws_bytes / CACHE_LINE_SIZE;
+    std::vector<uint32_t> order(lines);
+    for (size_t i = 0; i < lines; i++) {
+        order[i] = (uint32_t) i;
+    }
+    for (size_t i = lines - 1; i > 0; i--) {
+        size_t j = thread_rng().below(i);
+        uint32_t tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+    for (size_t i = 0; i < lines; i++) {
+        char* from = p + (size_t) order[i] * CACHE_LINE_SIZE;
+        char* to = p + (size_t) order[(i + 1) % lines] * CACHE_LINE_SIZE;
+        *(void**) from = to;
+    }
+    return (void**) (p + (size_t) order[0] * CACHE_LINE_SIZE);
+}
+
+// follow the chain for loads steps and return where it ended up.
+static inline void** chase(void** q, long loads) {
+    for (long i = 0; i < loads; i += 8) {
+        q = (void**) *q;
+        q = (void**) *q;
+        q = (void**) *q;
+        q = (void**) *q;
+        q = (void**) *q;
+        q = (void**) *q;
+        q = (void**) *q;
+        q = (void**) *q;
+    }
+    return q;
+}
+
+// sweep the working set from 4 KiB up to size (doubling, with a midpoint
+// between each doubling) and print ns/load, cycles/load and L1D/DTLB misses
+// per load at each step. the knees in ns/load are the L1/L2/LLC/DRAM
+// boundaries. falls back to TSC ticks when the cycle counter is unavailable.
+static inline int pointer_chase_sweep(char* p, size_t size) {
+    PerfCounterSet counters;
+    counters.add(CYCLES_EVENT);
+    counters.add(MEM_ACCESS_EVENTS, NUM_MEM_ACCESS_EVENTS);
+    bool counters_ok = counters.open();
+    bool have_cycles = false;
+    for (size_t n = 0; counters_ok && n < counters.names().size(); n++) {
+        have_cycles |= counters.names()[n] == CYCLES_EVENT.name;
+    }
+
+    printf("Pointer Chase, %d loads per size\n", POINTER_CHASE_LOADS);
+    printf("%12s %10s %12s %12s %12s\n", "WS (KiB)", "ns/load", have_cycles ? "cycles/load" : "tsc/load",
+           "L1D miss/ld", "DTLB miss/ld");
+    void* volatile sink;
+    std::vector<size_t> sizes;
+    for (size_t ws = 4096; ws <= size; ws *= 2) {
+        sizes.push_back(ws);
+        if (ws + ws / 2 <= size) {
+            sizes.push_back(ws + ws / 2);
+        }
+    }
+    for (size_t s = 0; s < sizes.size(); s++) {
+        size_t ws = sizes[s];
+        void** start = build_pointer_chase(p, ws);
+        size_t lines = ws / CACHE_LINE_SIZE;
+        // warm up: one full lap (capped) so the chain is resident where it fits.
+        start = chase(start, lines < POINTER_CHASE_LOADS ? (long) lines : POINTER_CHASE_LOADS);
+
+        counters.reset();
+        counters.enable();
+        uint64_t tsc_start = read_tsc();
+        double t_start = now_seconds();
+        sink = chase(start, POINTER_CHASE_LOADS);
+        double elapsed = now_seconds() - t_start;
+        uint64_t tsc = read_tsc() - tsc_start;
+        counters.disable();
+
+        double loads = POINTER_CHASE_LOADS;
+        double cycles = tsc / loads;
+        double l1d = 0, dtlb = 0;
+        if (counters_ok) {
+            std::map<std::string, uint64_t> v = counters.read();
+            if (have_cycles) {
+                cycles = counter_value(v, CYCLES_EVENT.name) / loads;
+            }
+            l1d = counter_value(v, "L1D Read Misses") / loads;
+            dtlb = counter_value(v, "DTLB Load Misses") / loads;
+        }
+        printf("%12zu %10.2f %12.1f %12.3f %12.3f\n", ws / 1024, elapsed * 1e9 / loads, cycles, l1d, dtlb);
+    }
+    (void) sink;
+    printf("------------------------\n");
+    return EXIT_SUCCESS;
+}
+
+#endif // POINTER_CHASE_H
@@ -0,0 +1,340 @@
+#ifndef REGION_H
+#define REGION_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h> // for open
+#include <sys/mman.h> // for mmap
+#include <sys/stat.h> // for S_IRWXU
+#include <cstdint> // for uintptr_t
+
+#include "allocators.h"
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define REGION_PAGE_SIZE 4096
+
+// heap regions.
+
+static inline char* malloc_region(size_t size) {
+    char* p = (char*) malloc(size);
+    if (p == nullptr) {
+        perror("Failure in malloc of pointer p.");
+        return nullptr;
+    }
+    printf("Success in malloc of pointer p.\n");
+    return p;
+}
+
+static inline char* calloc_region(size_t size) {
+    char* p = (char*) calloc(1, size);
+    if (p == nullptr) {
+        perror("Failure in calloc of pointer p.");
+        return nullptr;
+    }
+    printf("Success in calloc of pointer p.\n");
+    return p;
+}
+
+// page aligned; aligned_alloc wants the size to be a multiple of the alignment.
+static inline char* aligned_alloc_region(size_t size) {
+    size_t rounded = (size + REGION_PAGE_SIZE - 1) & ~((size_t) REGION_PAGE_SIZE - 1);
+    char* p = (char*) aligned_alloc(REGION_PAGE_SIZE, rounded);
+    if (p == nullptr) {
+        perror("Failure in aligned_alloc of pointer p.");
+        return nullptr;
+    }
+    printf("Success in aligned_alloc of pointer p.\n");
+    return p;
+}
+
+static inline void free_region(char* p, size_t size) {
+    (void) size;
+    free(p);
+}
+
+// anonymous mappings.
+
+static inline char* mmap_private_anon(size_t size) {
+    char* p = (char*) mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        perror("Oh no. Memory Allocation Failed.");
+        return nullptr;
+    } else {
+        printf("Memory Allocation Successful.\n");
+        return p;
+    }
+}
+
+// explicit 2 MiB hugetlb pages. needs pages reserved up front, e.g.
+// echo 512 > /proc/sys/vm/nr_hugepages for a 1 GiB region. the length is
+// rounded up to whole huge pages, which munmap needs as well (see
+// munmap_hugetlb_region).
+static inline size_t hugetlb_length(size_t size) {
+    return (size + HUGE_PAGE_SIZE - 1) & ~((size_t) HUGE_PAGE_SIZE - 1);
+}
+
+static inline char* mmap_private_anon_hugetlb(size_t size) {
+    char* p = (char*) mmap(nullptr, hugetlb_length(size), PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (21 << MAP_HUGE_SHIFT), -1, 0);
+    if (p == MAP_FAILED) {
+        perror("Oh no. Huge Page Allocation Failed (check /proc/sys/vm/nr_hugepages).");
+        return nullptr;
+    } else {
+        printf("Memory Allocation Successful.\n");
+        return p;
+    }
+}
+
+// anonymous memory aligned to a huge page boundary, so every 2 MiB of it can
+// be backed by a transparent huge page. maps one extra huge page and trims
+// the slack, leaving exactly size bytes mapped for munmap.
+static inline char* mmap_private_anon_aligned(size_t size) {
+    size_t len = size + HUGE_PAGE_SIZE;
+    char* raw = (char*) mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        perror("Oh no. Memory Allocation Failed.");
+        return nullptr;
+    }
+    uintptr_t aligned = ((uintptr_t) raw + HUGE_PAGE_SIZE - 1) & ~((uintptr_t) HUGE_PAGE_SIZE - 1);
+    char* p = (char*) aligned;
+    size_t head = p - raw;
+    size_t tail = len - head - size;
+    if (head > 0) {
+        munmap(raw, head);
+    }
+    if (tail > 0) {
+        munmap(p + size, tail);
+    }
+    return p;
+}
+
+// transparent huge pages on request (works when THP is "always" or "madvise").
+static inline char* mmap_private_anon_thp(size_t size) {
+    char* p = mmap_private_anon_aligned(size);
+    if (p == nullptr) {
+        return nullptr;
+    }
+    if (madvise(p, size, MADV_HUGEPAGE) == -1) {
+        perror("Oh no. MADV_HUGEPAGE Failed.");
+        munmap(p, size);
+        return nullptr;
+    }
+    printf("Memory Allocation Successful.\n");
+    return p;
+}
+
+// same mapping with THP explicitly turned off, the 4 KiB baseline.
+static inline char* mmap_private_anon_nothp(size_t size) {
+    char* p = mmap_private_anon_aligned(size);
+    if (p == nullptr) {
+        return nullptr;
+    }
+    if (madvise(p, size, MADV_NOHUGEPAGE) == -1) {
+        perror("Oh no. MADV_NOHUGEPAGE Failed.");
+        munmap(p, size);
+        return nullptr;
+    }
+    printf("Memory Allocation Successful.\n");
+    return p;
+}
+
+// file backed mappings. each variant keeps its own backing file so page
+// cache state from one does not leak into another.
+
+static inline char* mmap_file_backed(const char* path, size_t size, int flags) {
+    int fd = open(path, O_CREAT | O_RDWR, S_IRWXU);
+    if (fd == -1) {
+        perror("Oh no. File Open Failed.");
+        return nullptr;
+    } else {
+        printf("File Open Successful.\n");
+    }
+    if (ftruncate(fd, size) == -1) {
+        perror("Oh no. File Truncate Failed.");
+        close(fd);
+        return nullptr;
+    }
+    char* p = (char*) mmap(NULL, size, PROT_READ | PROT_WRITE, flags, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        perror("Oh no. Memory Allocation Failed.");
+        return nullptr;
+    } else {
+        printf("Memory Allocation Successful.\n");
+    }
+    return p;
+}
+
+static inline char* mmap_private_file_backed(size_t size) {
+    return mmap_file_backed("file_mmap_testing.txt", size, MAP_PRIVATE);
+}
+
+static inline char* mmap_private_file_backed_populate(size_t size) {
+    return mmap_file_backed("file_mmap_testing_2.txt", size, MAP_PRIVATE | MAP_POPULATE);
+}
+
+static inline char* mmap_shared_file_backed(size_t size) {
+    return mmap_file_backed("file_mmap_testing_3.txt", size, MAP_SHARED);
+}
+
+static inline char* mmap_shared_file_backed_populate(size_t size) {
+    return mmap_file_backed("file_mmap_testing_4.txt", size, MAP_SHARED | MAP_POPULATE);
+}
+
+static inline char* mmap_private_file_backed_memset(size_t size) {
+    char* p = mmap_file_backed("file_mmap_testing_5.txt", size, MAP_PRIVATE);
+    if (p != nullptr) {
+        memset(p, 0, size);
+    }
+    return p;
+}
+
+static inline void munmap_region(char* p, size_t size) {
+    if (munmap(p, size) == -1) {
+        perror("Oh no. Memory Deallocation Failed.");
+    } else {
+        printf("Memory Deallocation Successful.\n");
+    }
+}
+
+static inline void munmap_hugetlb_region(char* p, size_t size) {
+    munmap_region(p, hugetlb_length(size));
+}
+
+// regions carved from the allocators in allocators.h, one instance each for
+// the life of the process. a region is a single allocation, so release
+// hands it back and then drops whatever the allocator still holds.
+
+static BumpArena region_arena;
+static SlabPool region_slab;
+static PmrMonotonicAllocator region_pmr_monotonic;
+static PmrPoolAllocator region_pmr_pool;
+
+template <typename A, A* allocator>
+static char* allocator_region(size_t size) {
+    char* p = (char*) allocator->allocate(size);
+    if (p == nullptr) {
+        perror("Oh no. Allocator Region Failed.");
+        return nullptr;
+    }
+    printf("Memory Allocation Successful.\n");
+    return p;
+}
+
+template <typename A, A* allocator>
+static void allocator_release(char* p, size_t size) {
+    allocator->deallocate(p, size);
+    allocator->release();
+}
+
+// every region type the drivers can run on, looked up by name at runtime.
+struct region_type {
+    const char* name;
+    char* (*allocate)(size_t size);
+    void (*release)(char* p, size_t size);
+};
+
+static const region_type REGION_TYPES[] = {
+    {"malloc", malloc_region, free_region},
+    {"calloc", calloc_region, free_region},
+    {"aligned_alloc", aligned_alloc_region, free_region},
+    {"mmap_private_anon", mmap_private_anon, munmap_region},
+    {"mmap_private_anon_hugetlb", mmap_private_anon_hugetlb, munmap_hugetlb_region},
+    {"mmap_private_anon_thp", mmap_private_anon_thp, munmap_region},
+    {"mmap_private_anon_nothp", mmap_private_anon_nothp, munmap_region},
+    {"mmap_private_file_backed", mmap_private_file_backed, munmap_region},
+    {"mmap_private_file_backed_populate", mmap_private_file_backed_populate, munmap_region},
+    {"mmap_shared_file_backed", mmap_shared_file_backed, munmap_region},
+    {"mmap_shared_file_backed_populate", mmap_shared_file_backed_populate, munmap_region},
+    {"mmap_private_file_backed_memset", mmap_private_file_backed_memset, munmap_region},
+    {"arena", allocator_region<BumpArena, &region_arena>, allocator_release<BumpArena, &region_arena>},
+    {"slab", allocator_region<SlabPool, &region_slab>, allocator_release<SlabPool, &region_slab>},
+    {"pmr_monotonic", allocator_region<PmrMonotonicAllocator, &region_pmr_monotonic>,
+     allocator_release<PmrMonotonicAllocator, &region_pmr_monotonic>},
+    {"pmr_pool", allocator_region<PmrPoolAllocator, &region_pmr_pool>,
+     allocator_release<PmrPoolAllocator, &region_pmr_pool>},
+};
+
+static const size_t NUM_REGION_TYPES = sizeof(REGION_TYPES) / sizeof(REGION_TYPES[0]);
+
+// nullptr (and a list of valid names) for an unknown type.
+static inline const region_type* find_region_type(const char* name) {
+    for (size_t i = 0; i < NUM_REGION_TYPES; i++) {
+        if (strcmp(REGION_TYPES[i].name, name) == 0) {
+            return &REGION_TYPES[i];
+        }
+    }
+    printf("Unknown region type %s, expected one of:", name);
+    for (size_t i = 0; i < NUM_REGION_TYPES; i++) {
+        printf(" %s", REGION_TYPES[i].name);
+    }
+    printf("\n");
+    return nullptr;
+}
+
+// the system wide THP mode, e.g. "always [madvise] never".
+static inline void print_thp_setting() {
+    char buffer[256];
+    FILE* file = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (file == nullptr) {
+        printf("THP Setting: unavailable\n");
+        return;
+    }
+    if (fgets(buffer, sizeof(buffer), file) != nullptr) {
+        printf("THP Setting: %s", buffer);
+    }
+    fclose(file);
+}
+
+// walk /proc/self/smaps and report how much of [p, p + size) is actually
+// backed by huge pages, transparent or hugetlb.
+static inline int report_huge_page_backing(char* p, size_t size) {
+    FILE* file = fopen("/proc/self/smaps", "r");
+    if (file == nullptr) {
+        perror("Error in system call fopen");
+        return EXIT_FAILURE;
+    }
+    char buffer[1024];
+    uintptr_t start = (uintptr_t) p;
+    uintptr_t end = start + size;
+    bool in_region = false;
+    unsigned long kb, thp_kb = 0, hugetlb_kb = 0, rss_kb = 0, page_kb = 0;
+    while (fgets(buffer, sizeof(buffer), file) != nullptr) {
+        unsigned long lo, hi;
+        char perms[8];
+        // vma header lines look like "7f..-7f.. rw-p ...", field lines like "Rss:   4 kB".
+        if (sscanf(buffer, "%lx-%lx %7s", &lo, &hi, perms) == 3) {
+            in_region = lo < end && hi > start;
+            continue;
+        }
+        if (!in_region) {
+            continue;
+        }
+        if (sscanf(buffer, "Rss: %lu kB", &kb) == 1) {
+            rss_kb += kb;
+        } else if (sscanf(buffer, "AnonHugePages: %lu kB", &kb) == 1 ||
+                   sscanf(buffer, "ShmemPmdMapped: %lu kB", &kb) == 1 ||
+                   sscanf(buffer, "FilePmdMapped: %lu kB", &kb) == 1) {
+            thp_kb += kb;
+        } else if (sscanf(buffer, "Private_Hugetlb: %lu kB", &kb) == 1 ||
+                   sscanf(buffer, "Shared_Hugetlb: %lu kB", &kb) == 1) {
+            hugetlb_kb += kb;
+        } else if (sscanf(buffer, "KernelPageSize: %lu kB", &kb) == 1) {
+            page_kb = kb;
+        }
+    }
+    fclose(file);
+    unsigned long huge_kb = thp_kb + hugetlb_kb;
+    // hugetlb pages are not counted in Rss.
+    unsigned long resident_kb = rss_kb + hugetlb_kb;
+    printf("Kernel Page Size: %lu kB\n", page_kb);
+    printf("Resident: %lu MiB, THP Backed: %lu MiB, Hugetlb Backed: %lu MiB\n",
+           resident_kb / 1024, thp_kb / 1024, hugetlb_kb / 1024);
+    printf("Huge Page Coverage: %.1f%% of resident, %.1f%% of region\n",
+           resident_kb ? 100.0 * huge_kb / resident_kb : 0.0, 100.0 * huge_kb / (size / 1024));
+    return EXIT_SUCCESS;
+}
+
+#endif // REGION_H
@@ -0,0 +1,342 @@
+#ifndef RESULTS_WRITER_H
+#define RESULTS_WRITER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h> // for gethostname
+#include <sys/utsname.h> // for uname
+#include <sys/resource.h>
+#include <cinttypes> // for PRIu64
+#include <map>
+#include <string>
+#include <vector>
+
+#include "mem_access.h"
+
+// counter names ("L1D Read Misses") as record keys ("l1d_read_misses"):
+// lower case, every run of other characters one underscore. every key the
+// writers emit is snake_case so the output is easy to query.
+static inline std::string field_key(const std::string& name) {
+    std::string key;
+    for (size_t i = 0; i < name.size(); i++) {
+        char c = name[i];
+        if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) {
+            key += c;
+        } else if (c >= 'A' && c <= 'Z') {
+            key += (char) (c - 'A' + 'a');
+        } else if (!key.empty() && key.back() != '_') {
+            key += '_';
+        }
+    }
+    while (!key.empty() && key.back() == '_') {
+        key.pop_back();
+    }
+    return key;
+}
+
+// one structured result: ordered name -> value fields, numbers kept apart
+// from strings so JSON output can leave them unquoted.
+class ResultRecord {
+public:
+    void add(const std::string& name, const std::string& value) { set(name, value, false); }
+    void add(const std::string& name, const char* value) { set(name, value ? value : "", false); }
+
+    void add(const std::string& name, double value) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%.9g", value);
+        set(name, buf, true);
+    }
+
+    void add(const std::string& name, uint64_t value) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%" PRIu64, value);
+        set(name, buf, true);
+    }
+
+    // integers keep every digit; "%.9g" would round counts past 1e9.
+    void add(const std::string& name, long value) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%ld", value);
+        set(name, buf, true);
+    }
+
+    void add(const std::string& name, int value) {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%d", value);
+        set(name, buf, true);
+    }
+
+    // copy every field of another record (e.g. the run metadata).
+    void add(const ResultRecord& other) {
+        for (size_t i = 0; i < other.fields_.size(); i++) {
+            set(other.fields_[i].name, other.fields_[i].value, other.fields_[i].number);
+        }
+    }
+
+    struct field {
+        std::string name;
+        std::string value;
+        bool number;
+    };
+
+    const std::vector<field>& fields() const { return fields_; }
+
+private:
+    void set(const std::string& name, const std::string& value, bool number) {
+        for (size_t i = 0; i < fields_.size(); i++) {
+            if (fields_[i].name == name) {
+                fields_[i].value = value;
+                fields_[i].number = number;
+                return;
+            }
+        }
+        field f;
+        f.name = name;
+        f.value = value;
+        f.number = number;
+        fields_.push_back(f);
+    }
+
+    std::vector<field> fields_;
+};
+
+// first line of a small file, without the newline. "" if unreadable.
+static inline std::string read_first_line(const char* path) {
+    char buffer[512];
+    std::string line;
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        return line;
+    }
+    if (fgets(buffer, sizeof(buffer), file) != nullptr) {
+        line = buffer;
+        while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) {
+            line.pop_back();
+        }
+    }
+    fclose(file);
+    return line;
+}
+
+// what the run was on: host, kernel, cpu model, THP mode, start time.
+static inline ResultRecord collect_run_metadata() {
+    ResultRecord meta;
+    char host[256] = "";
+    gethostname(host, sizeof(host) - 1);
+    meta.add("host", host);
+
+    struct utsname uts;
+    if (uname(&uts) == 0) {
+        meta.add("kernel", std::string(uts.sysname) + " " + uts.release);
+        meta.add("arch", uts.machine);
+    }
+
+    std::string model;
+    char buffer[512];
+    FILE* file = fopen("/proc/cpuinfo", "r");
+    if (file != nullptr) {
+        while (fgets(buffer, sizeof(buffer), file) != nullptr) {
+            char* colon = strchr(buffer, ':');
+            if (strncmp(buffer, "model name", 10) == 0 && colon != nullptr) {
+                model = colon + 2;
+                while (!model.empty() && model.back() == '\n') {
+                    model.pop_back();
+                }
+                break;
+            }
+        }
+        fclose(file);
+    }
+    meta.add("cpu_model", model);
+    meta.add("thp", read_first_line("/sys/kernel/mm/transparent_hugepage/enabled"));
+
+    char stamp[64];
+    time_t now = time(nullptr);
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    meta.add("start_time", stamp);
+    return meta;
+}
+
+static inline double timeval_seconds(const struct timeval& tv) {
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// rusage differences across a measured window.
+static inline void add_rusage_delta(ResultRecord& record, const struct rusage& before, const struct rusage& after) {
+    record.add("utime_s", timeval_seconds(after.ru_utime) - timeval_seconds(before.ru_utime));
+    record.add("stime_s", timeval_seconds(after.ru_stime) - timeval_seconds(before.ru_stime));
+    record.add("maxrss_kb", after.ru_maxrss);
+    record.add("minflt", after.ru_minflt - before.ru_minflt);
+    record.add("majflt", after.ru_majflt - before.ru_majflt);
+    record.add("inblock", after.ru_inblock - before.ru_inblock);
+    record.add("oublock", after.ru_oublock - before.ru_oublock);
+    record.add("nvcsw", after.ru_nvcsw - before.ru_nvcsw);
+    record.add("nivcsw", after.ru_nivcsw - before.ru_nivcsw);
+}
+
+// every counter under its own (snake_case) name, plus miss ratios and misses per KiB
+// touched. counters that were not measured this trial (rotation) are left
+// out rather than written as zero.
+static inline void add_counter_fields(ResultRecord& record, const std::map<std::string, uint64_t>& values,
+                                      double bytes_touched) {
+    for (std::map<std::string, uint64_t>::const_iterator it = values.begin(); it != values.end(); ++it) {
+        record.add(field_key(it->first), it->second);
+    }
+    static const char* const RATIOS[][3] = {
+        {"l1d_read_miss_ratio", "L1D Read Misses", "L1D Read Accesses"},
+        {"l1d_write_miss_ratio", "L1D Write Misses", "L1D Write Accesses"},
+        {"l1d_prefetch_miss_ratio", "L1D Prefetch Misses", "L1D Prefetch Accesses"},
+        {"dtlb_load_miss_ratio", "DTLB Load Misses", "DTLB Load Accesses"},
+        {"dtlb_store_miss_ratio", "DTLB Store Misses", "DTLB Store Accesses"},
+    };
+    for (size_t r = 0; r < sizeof(RATIOS) / sizeof(RATIOS[0]); r++) {
+        if (values.count(RATIOS[r][1]) && values.count(RATIOS[r][2])) {
+            record.add(RATIOS[r][0], miss_rate(counter_value(values, RATIOS[r][1]),
+                                               counter_value(values, RATIOS[r][2])));
+        }
+    }
+    double kib = bytes_touched / 1024;
+    if (kib > 0 && values.count("L1D Read Misses") && values.count("L1D Write Misses")) {
+        record.add("l1d_misses_per_kib",
+                   (counter_value(values, "L1D Read Misses") + counter_value(values, "L1D Write Misses")) / kib);
+    }
+    if (kib > 0 && values.count("DTLB Load Misses") && values.count("DTLB Store Misses")) {
+        record.add("dtlb_misses_per_kib",
+                   (counter_value(values, "DTLB Load Misses") + counter_value(values, "DTLB Store Misses")) / kib);
+    }
+}
+
+// collects records in memory and writes them all on close, so nothing is
+// formatted or written while a trial is being measured. csv gets a header
+// with the union of every record's fields (first-seen order); json writes
+// one object per line.
+class ResultsWriter {
+public:
+    ResultsWriter() : json_(false) {}
+    ~ResultsWriter() { close(); }
+
+    // format is "csv" or "json".
+    bool open(const char* path, const char* format) {
+        path_ = path;
+        json_ = strcmp(format, "json") == 0;
+        if (!json_ && strcmp(format, "csv") != 0) {
+            printf("Unknown results format: %s\n", format);
+            return false;
+        }
+        // fail early rather than after a long run.
+        FILE* file = fopen(path, "w");
+        if (file == nullptr) {
+            perror("Error in system call fopen");
+            return false;
+        }
+        fclose(file);
+        return true;
+    }
+
+    void add(const ResultRecord& record) { records_.push_back(record); }
+
+    bool close() {
+        if (path_.empty()) {
+            return true;
+        }
+        FILE* file = fopen(path_.c_str(), "w");
+        if (file == nullptr) {
+            perror("Error in system call fopen");
+            return false;
+        }
+        if (json_) {
+            write_json(file);
+        } else {
+            write_csv(file);
+        }
+        bool ok = fclose(file) == 0;
+        printf("Wrote %zu records to %s.\n", records_.size(), path_.c_str());
+        path_.clear();
+        records_.clear();
+        return ok;
+    }
+
+private:
+    static std::string csv_quote(const std::string& s) {
+        if (s.find_first_of(",\"\n") == std::string::npos) {
+            return s;
+        }
+        std::string out = "\"";
+        for (size_t i = 0; i < s.size(); i++) {
+            if (s[i] == '"') {
+                out += '"';
+            }
+            out += s[i];
+        }
+        return out + "\"";
+    }
+
+    static std::string json_quote(const std::string& s) {
+        std::string out = "\"";
+        for (size_t i = 0; i < s.size(); i++) {
+            char c = s[i];
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            } else if ((unsigned char) c < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out += buf;
+            } else {
+                out += c;
+            }
+        }
+        return out + "\"";
+    }
+
+    void write_csv(FILE* file) const {
+        std::vector<std::string> columns;
+        std::map<std::string, size_t> index;
+        for (size_t r = 0; r < records_.size(); r++) {
+            const std::vector<ResultRecord::field>& fields = records_[r].fields();
+            for (size_t f = 0; f < fields.size(); f++) {
+                if (index.find(fields[f].name) == index.end()) {
+                    index[fields[f].name] = columns.size();
+                    columns.push_back(fields[f].name);
+                }
+            }
+        }
+        for (size_t c = 0; c < columns.size(); c++) {
+            fprintf(file, "%s%s", c ? "," : "", csv_quote(columns[c]).c_str());
+        }
+        fprintf(file, "\n");
+        for (size_t r = 0; r < records_.size(); r++) {
+            std::vector<std::string> row(columns.size());
+            const std::vector<ResultRecord::field>& fields = records_[r].fields();
+            for (size_t f = 0; f < fields.size(); f++) {
+                row[index[fields[f].name]] = fields[f].value;
+            }
+            for (size_t c = 0; c < row.size(); c++) {
+                fprintf(file, "%s%s", c ? "," : "", csv_quote(row[c]).c_str());
+            }
+            fprintf(file, "\n");
+        }
+    }
+
+    void write_json(FILE* file) const {
+        for (size_t r = 0; r < records_.size(); r++) {
+            const std::vector<ResultRecord::field>& fields = records_[r].fields();
+            fprintf(file, "{");
+            for (size_t f = 0; f < fields.size(); f++) {
+                const std::string& v = fields[f].value;
+                bool bare = fields[f].number && v != "nan" && v != "inf" && v != "-inf";
+                fprintf(file, "%s%s: %s", f ? ", " : "", json_quote(fields[f].name).c_str(),
+                        bare ? v.c_str() : json_quote(v).c_str());
+            }
+            fprintf(file, "}\n");
+        }
+    }
+
+    std::string path_;
+    bool json_;
+    std::vector<ResultRecord> records_;
+};
+
+#endif // RESULTS_WRITER_H
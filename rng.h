@@ -0,0 +1,137 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stddef.h>
+#include <cstdint> // for uint64_t
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RNG_X86 1
+#endif
+
+// splitmix64, only used to expand a seed into generator state.
+static inline uint64_t splitmix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl64(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+// map a 64-bit random value onto [0, n) with a multiply and a shift instead
+// of a modulo (lemire's reduction).
+static inline uint64_t fast_range(uint64_t r, uint64_t n) {
+    return (uint64_t) (((unsigned __int128) r * n) >> 64);
+}
+
+// xoshiro256**, one per thread. no globals, so threads never share state.
+struct Xoshiro256ss {
+    uint64_t s[4];
+
+    explicit Xoshiro256ss(uint64_t seed = 1) { reseed(seed); }
+
+    void reseed(uint64_t seed) {
+        for (int i = 0; i < 4; i++) {
+            s[i] = splitmix64(seed);
+        }
+    }
+
+    uint64_t next() {
+        uint64_t result = rotl64(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl64(s[3], 45);
+        return result;
+    }
+
+    // uniform in [0, n).
+    uint64_t below(uint64_t n) { return fast_range(next(), n); }
+
+    // uniform double in [0, 1).
+    double unit() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+};
+
+// four independent xoshiro256** streams stepped together, for filling index
+// buffers in bulk. with AVX2 all four lanes advance in one set of vector ops
+// (the * 5 and * 9 become shift + add since AVX2 has no 64-bit multiply);
+// otherwise the same lanes are stepped one by one, giving identical output.
+struct Xoshiro256ssx4 {
+    alignas(32) uint64_t s[4][4]; // s[word][lane]
+
+    explicit Xoshiro256ssx4(uint64_t seed = 1) {
+        for (int lane = 0; lane < 4; lane++) {
+            for (int i = 0; i < 4; i++) {
+                s[i][lane] = splitmix64(seed);
+            }
+        }
+    }
+
+    // write n values (n a multiple of 4), lanes interleaved.
+    void fill(uint64_t* out, size_t n) {
+#ifdef RNG_X86
+        if (__builtin_cpu_supports("avx2")) {
+            fill_avx2(out, n);
+            return;
+        }
+#endif
+        for (size_t i = 0; i < n; i += 4) {
+            for (int lane = 0; lane < 4; lane++) {
+                uint64_t s1 = s[1][lane];
+                out[i + lane] = rotl64(s1 * 5, 7) * 9;
+                uint64_t t = s1 << 17;
+                s[2][lane] ^= s[0][lane];
+                s[3][lane] ^= s[1][lane];
+                s[1][lane] ^= s[2][lane];
+                s[0][lane] ^= s[3][lane];
+                s[2][lane] ^= t;
+                s[3][lane] = rotl64(s[3][lane], 45);
+            }
+        }
+    }
+
+#ifdef RNG_X86
+    __attribute__((target("avx2")))
+    void fill_avx2(uint64_t* out, size_t n) {
+        __m256i s0 = _mm256_load_si256((const __m256i*) s[0]);
+        __m256i s1 = _mm256_load_si256((const __m256i*) s[1]);
+        __m256i s2 = _mm256_load_si256((const __m256i*) s[2]);
+        __m256i s3 = _mm256_load_si256((const __m256i*) s[3]);
+        for (size_t i = 0; i < n; i += 4) {
+            __m256i m5 = _mm256_add_epi64(_mm256_slli_epi64(s1, 2), s1);
+            __m256i r = _mm256_or_si256(_mm256_slli_epi64(m5, 7), _mm256_srli_epi64(m5, 57));
+            __m256i m9 = _mm256_add_epi64(_mm256_slli_epi64(r, 3), r);
+            _mm256_storeu_si256((__m256i*) (out + i), m9);
+            __m256i t = _mm256_slli_epi64(s1, 17);
+            s2 = _mm256_xor_si256(s2, s0);
+            s3 = _mm256_xor_si256(s3, s1);
+            s1 = _mm256_xor_si256(s1, s2);
+            s0 = _mm256_xor_si256(s0, s3);
+            s2 = _mm256_xor_si256(s2, t);
+            s3 = _mm256_or_si256(_mm256_slli_epi64(s3, 45), _mm256_srli_epi64(s3, 19));
+        }
+        _mm256_store_si256((__m256i*) s[0], s0);
+        _mm256_store_si256((__m256i*) s[1], s1);
+        _mm256_store_si256((__m256i*) s[2], s2);
+        _mm256_store_si256((__m256i*) s[3], s3);
+    }
+#endif
+};
+
+// the calling thread's generator.
+static inline Xoshiro256ss& thread_rng() {
+    thread_local Xoshiro256ss rng(1);
+    return rng;
+}
+
+// give the calling thread its own random stream.
+static inline void seed_thread_rng(uint64_t seed) {
+    thread_rng().reseed(seed + 1);
+}
+
+#endif // RNG_H
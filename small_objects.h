@@ -0,0 +1,261 @@
+#ifndef SMALL_OBJECTS_H
+#define SMALL_OBJECTS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h> // for getrusage
+#include <cstdint> // for uint64_t, uintptr_t
+#include <map>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "allocators.h"
+#include "mem_access.h" // for now_seconds
+#include "results_writer.h" // for timeval_seconds, counter_value
+
+// many small objects from one allocator instead of one big region: build
+// count objects of size bytes, free every other one and allocate them again
+// (so a free list has to hand slots back), then walk them in allocation
+// order touching every line of each, the way a pointer-linked structure is
+// read. each allocator is timed and counted the same way.
+struct phase_usage {
+    double utime_s;
+    double stime_s;
+    long minflt;
+};
+
+struct small_object_result {
+    bool failed;                                // an allocate() returned null
+    double alloc_ns;                            // per allocate, build and refill
+    double free_ns;                             // per deallocate, the churn pass
+    double walk_ns;                             // per object per pass
+    double teardown_ns;                         // per object, deallocate + release
+    phase_usage alloc;                          // build and refill
+    phase_usage free;                           // churn and teardown
+    size_t pages;                               // distinct 4 KiB pages holding objects
+    bool counters_ok;
+    std::map<std::string, uint64_t> values;     // over the walk only
+};
+
+// add the rusage between before and now to phase.
+static inline void add_phase_usage(phase_usage& phase, const struct rusage& before) {
+    struct rusage after;
+    getrusage(RUSAGE_SELF, &after);
+    phase.utime_s += timeval_seconds(after.ru_utime) - timeval_seconds(before.ru_utime);
+    phase.stime_s += timeval_seconds(after.ru_stime) - timeval_seconds(before.ru_stime);
+    phase.minflt += after.ru_minflt - before.ru_minflt;
+}
+
+// allocate and fill objects[i] for i = first, first + step, ... false as
+// soon as the allocator runs dry.
+template <typename A>
+static bool allocate_objects(A& allocator, std::vector<char*>& objects, size_t first, size_t step, size_t size) {
+    for (size_t i = first; i < objects.size(); i += step) {
+        objects[i] = (char*) allocator.allocate(size);
+        if (objects[i] == nullptr) {
+            return false;
+        }
+        memset(objects[i], (int) i, size);
+    }
+    return true;
+}
+
+// sum a word of every line of every object, so the walk costs what the
+// layout costs. every word read lies inside the object: the last one is
+// read on its own when the line stride steps past it. size >= 8.
+__attribute__((noinline))
+static uint64_t walk_objects(const std::vector<char*>& objects, size_t size, int passes) {
+    uint64_t sum = 0;
+    const size_t last = size - sizeof(uint64_t);
+    for (int pass = 0; pass < passes; pass++) {
+        for (size_t i = 0; i < objects.size(); i++) {
+            const char* o = objects[i];
+            size_t off = 0;
+            for (; off + sizeof(uint64_t) <= size; off += CACHE_LINE_SIZE) {
+                sum += *(const volatile uint64_t*) (o + off);
+            }
+            if (off - CACHE_LINE_SIZE < last) {
+                sum += *(const volatile uint64_t*) (o + last);
+            }
+        }
+    }
+    return sum;
+}
+
+template <typename A>
+static small_object_result run_small_objects(size_t count, size_t size, int passes,
+                                             const std::vector<perf_event_spec>& events) {
+    small_object_result r = small_object_result();
+    A allocator;
+    std::vector<char*> objects(count, nullptr);
+    struct rusage before;
+
+    getrusage(RUSAGE_SELF, &before);
+    double start = now_seconds();
+    bool ok = allocate_objects(allocator, objects, 0, 1, size);
+    double built = now_seconds() - start;
+    add_phase_usage(r.alloc, before);
+
+    if (ok) {
+        getrusage(RUSAGE_SELF, &before);
+        start = now_seconds();
+        for (size_t i = 0; i < count; i += 2) {
+            allocator.deallocate(objects[i], size);
+            objects[i] = nullptr;
+        }
+        r.free_ns = (now_seconds() - start) * 1e9 / ((count + 1) / 2);
+        add_phase_usage(r.free, before);
+
+        getrusage(RUSAGE_SELF, &before);
+        start = now_seconds();
+        ok = allocate_objects(allocator, objects, 0, 2, size);
+        r.alloc_ns = (built + now_seconds() - start) * 1e9 / (count + (count + 1) / 2);
+        add_phase_usage(r.alloc, before);
+    }
+    if (!ok) {
+        printf("Oh no. Object Allocation Failed.\n");
+        for (size_t i = 0; i < count; i++) {
+            if (objects[i] != nullptr) {
+                allocator.deallocate(objects[i], size);
+            }
+        }
+        allocator.release();
+        r.failed = true;
+        return r;
+    }
+
+    std::unordered_set<uintptr_t> pages;
+    for (size_t i = 0; i < count; i++) {
+        uintptr_t first = (uintptr_t) objects[i] / REGION_PAGE_SIZE;
+        uintptr_t last = ((uintptr_t) objects[i] + size - 1) / REGION_PAGE_SIZE;
+        for (uintptr_t pg = first; pg <= last; pg++) {
+            pages.insert(pg);
+        }
+    }
+    r.pages = pages.size();
+
+    PerfCounterSet counters;
+    counters.add(events.data(), events.size());
+    r.counters_ok = !events.empty() && counters.open();
+    counters.reset();
+    counters.enable();
+    start = now_seconds();
+    volatile uint64_t sink = walk_objects(objects, size, passes);
+    r.walk_ns = (now_seconds() - start) * 1e9 / ((double) count * passes);
+    counters.disable();
+    if (r.counters_ok) {
+        r.values = counters.read();
+    }
+    (void) sink;
+
+    getrusage(RUSAGE_SELF, &before);
+    start = now_seconds();
+    for (size_t i = 0; i < count; i++) {
+        allocator.deallocate(objects[i], size);
+    }
+    allocator.release();
+    r.teardown_ns = (now_seconds() - start) * 1e9 / count;
+    add_phase_usage(r.free, before);
+    return r;
+}
+
+struct small_object_allocator {
+    const char* name;
+    small_object_result (*run)(size_t count, size_t size, int passes, const std::vector<perf_event_spec>& events);
+};
+
+static const small_object_allocator SMALL_OBJECT_ALLOCATORS[] = {
+    {"malloc", run_small_objects<MallocAllocator>},
+    {"arena", run_small_objects<BumpArena>},
+    {"slab", run_small_objects<SlabPool>},
+    {"pmr_monotonic", run_small_objects<PmrMonotonicAllocator>},
+    {"pmr_pool", run_small_objects<PmrPoolAllocator>},
+};
+
+static const size_t NUM_SMALL_OBJECT_ALLOCATORS = sizeof(SMALL_OBJECT_ALLOCATORS) / sizeof(SMALL_OBJECT_ALLOCATORS[0]);
+
+// every allocator, or only the named one, over total / size objects. the
+// walk counters are events (MEM_ACCESS_EVENTS when empty), whichever of
+// them this PMU has.
+static inline int small_object_compare(size_t total, size_t size, int passes, const char* only,
+                                       const std::vector<perf_event_spec>& wanted) {
+    if (size < sizeof(uint64_t) || total < size) {
+        printf("Objects must be at least %zu bytes and fit the region.\n", sizeof(uint64_t));
+        return EXIT_FAILURE;
+    }
+    bool found = only == nullptr;
+    for (size_t a = 0; a < NUM_SMALL_OBJECT_ALLOCATORS; a++) {
+        found |= only != nullptr && strcmp(only, SMALL_OBJECT_ALLOCATORS[a].name) == 0;
+    }
+    if (!found) {
+        printf("Unknown allocator %s, expected one of:", only);
+        for (size_t a = 0; a < NUM_SMALL_OBJECT_ALLOCATORS; a++) {
+            printf(" %s", SMALL_OBJECT_ALLOCATORS[a].name);
+        }
+        printf("\n");
+        return EXIT_FAILURE;
+    }
+
+    std::vector<perf_event_spec> all(wanted);
+    if (all.empty()) {
+        all.assign(MEM_ACCESS_EVENTS, MEM_ACCESS_EVENTS + NUM_MEM_ACCESS_EVENTS);
+    }
+    for (size_t i = 0; i < all.size(); i++) {
+        all[i].optional = true;
+    }
+    std::vector<perf_event_spec> events;
+    {
+        PerfCounterSet probe;
+        probe.add(all.data(), all.size());
+        probe.open();
+        for (size_t i = 0; i < all.size(); i++) {
+            for (size_t n = 0; n < probe.names().size(); n++) {
+                if (probe.names()[n] == all[i].name) {
+                    events.push_back(all[i]);
+                }
+            }
+        }
+    }
+
+    size_t count = total / size;
+    printf("Small Objects, %zu x %zu B, %d walk passes\n", count, size, passes);
+    // user / sys / minflt split into the allocating phase (build, refill)
+    // and the freeing phase (churn, teardown).
+    printf("%-14s %9s %9s %9s %9s %8s %8s %8s %8s %8s %8s %9s %9s %9s\n", "Allocator", "Alloc ns", "Free ns",
+           "Walk ns", "Tear ns", "A User s", "A Sys s", "A MinFlt", "F User s", "F Sys s", "F MinFlt", "Pages",
+           "L1D Mis", "DTLB Mis");
+    for (size_t a = 0; a < NUM_SMALL_OBJECT_ALLOCATORS; a++) {
+        if (only != nullptr && strcmp(only, SMALL_OBJECT_ALLOCATORS[a].name) != 0) {
+            continue;
+        }
+        small_object_result r = SMALL_OBJECT_ALLOCATORS[a].run(count, size, passes, events);
+        if (r.failed) {
+            printf("%-14s allocation failed, skipped\n", SMALL_OBJECT_ALLOCATORS[a].name);
+            fflush(stdout);
+            continue;
+        }
+        printf("%-14s %9.1f %9.1f %9.2f %9.1f %8.3f %8.3f %8ld %8.3f %8.3f %8ld %9zu",
+               SMALL_OBJECT_ALLOCATORS[a].name, r.alloc_ns, r.free_ns, r.walk_ns, r.teardown_ns, r.alloc.utime_s,
+               r.alloc.stime_s, r.alloc.minflt, r.free.utime_s, r.free.stime_s, r.free.minflt, r.pages);
+        // misses per object per pass.
+        const std::map<std::string, uint64_t>& v = r.values;
+        double visits = (double) count * passes;
+        if (r.counters_ok && (v.count("L1D Read Misses") || v.count("L1D Write Misses"))) {
+            printf(" %9.3f", (counter_value(v, "L1D Read Misses") + counter_value(v, "L1D Write Misses")) / visits);
+        } else {
+            printf(" %9s", "-");
+        }
+        if (r.counters_ok && (v.count("DTLB Load Misses") || v.count("DTLB Store Misses"))) {
+            printf(" %9.4f\n", (counter_value(v, "DTLB Load Misses") + counter_value(v, "DTLB Store Misses")) / visits);
+        } else {
+            printf(" %9s\n", "-");
+        }
+        fflush(stdout);
+    }
+    printf("------------------------\n");
+    return EXIT_SUCCESS;
+}
+
+#endif // SMALL_OBJECTS_H
@@ -0,0 +1,206 @@
+#ifndef STREAM_BANDWIDTH_H
+#define STREAM_BANDWIDTH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h> // for pthread_barrier_t
+#include <cstdint> // for uintptr_t
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define STREAM_X86 1
+#endif
+
+#include "mem_access.h"
+
+// timed repetitions of each kernel; the best one is reported, as in STREAM.
+#define STREAM_REPS 5
+
+enum stream_kernel { STREAM_COPY, STREAM_SCALE, STREAM_ADD, STREAM_TRIAD, STREAM_NUM_KERNELS };
+
+static const char* const STREAM_KERNEL_NAMES[STREAM_NUM_KERNELS] = { "Copy", "Scale", "Add", "Triad" };
+
+// bytes counted per element, STREAM convention (no write-allocate traffic).
+static const int STREAM_KERNEL_BYTES[STREAM_NUM_KERNELS] = { 16, 16, 24, 24 };
+
+// copy:  c = a
+// scale: b = s * c
+// add:   c = a + b
+// triad: a = b + s * c
+typedef void (*stream_fn)(int kernel, double* a, double* b, double* c, size_t n, double s);
+
+// plain loops, kept scalar so this is the no-SIMD baseline.
+#if defined(__GNUC__) && !defined(__clang__)
+__attribute__((optimize("no-tree-vectorize")))
+#endif
+static void stream_scalar(int kernel, double* a, double* b, double* c, size_t n, double s) {
+    switch (kernel) {
+    case STREAM_COPY:  for (size_t i = 0; i < n; i++) c[i] = a[i]; break;
+    case STREAM_SCALE: for (size_t i = 0; i < n; i++) b[i] = s * c[i]; break;
+    case STREAM_ADD:   for (size_t i = 0; i < n; i++) c[i] = a[i] + b[i]; break;
+    case STREAM_TRIAD: for (size_t i = 0; i < n; i++) a[i] = b[i] + s * c[i]; break;
+    }
+}
+
+#ifdef STREAM_X86
+// the four kernels for one vector width. STORE is either the normal aligned
+// store or the non-temporal (streaming) one. n is a multiple of the width and
+// the arrays are 64-byte aligned, see stream_bandwidth_sweep.
+#define STREAM_SIMD_KERNELS(VEC, W, LOAD, STORE, ADD, MUL, SET1)              \
+    VEC vs = SET1(s);                                                         \
+    switch (kernel) {                                                         \
+    case STREAM_COPY:                                                         \
+        for (size_t i = 0; i < n; i += W) STORE(c + i, LOAD(a + i));          \
+        break;                                                                \
+    case STREAM_SCALE:                                                        \
+        for (size_t i = 0; i < n; i += W) STORE(b + i, MUL(vs, LOAD(c + i))); \
+        break;                                                                \
+    case STREAM_ADD:                                                          \
+        for (size_t i = 0; i < n; i += W)                                     \
+            STORE(c + i, ADD(LOAD(a + i), LOAD(b + i)));                      \
+        break;                                                                \
+    case STREAM_TRIAD:                                                        \
+        for (size_t i = 0; i < n; i += W)                                     \
+            STORE(a + i, ADD(LOAD(b + i), MUL(vs, LOAD(c + i))));             \
+        break;                                                                \
+    }
+
+__attribute__((target("sse2")))
+static void stream_sse(int kernel, double* a, double* b, double* c, size_t n, double s) {
+    STREAM_SIMD_KERNELS(__m128d, 2, _mm_load_pd, _mm_store_pd, _mm_add_pd, _mm_mul_pd, _mm_set1_pd)
+}
+
+__attribute__((target("sse2")))
+static void stream_sse_nt(int kernel, double* a, double* b, double* c, size_t n, double s) {
+    STREAM_SIMD_KERNELS(__m128d, 2, _mm_load_pd, _mm_stream_pd, _mm_add_pd, _mm_mul_pd, _mm_set1_pd)
+    _mm_sfence();
+}
+
+__attribute__((target("avx2")))
+static void stream_avx2(int kernel, double* a, double* b, double* c, size_t n, double s) {
+    STREAM_SIMD_KERNELS(__m256d, 4, _mm256_load_pd, _mm256_store_pd, _mm256_add_pd, _mm256_mul_pd, _mm256_set1_pd)
+}
+
+__attribute__((target("avx2")))
+static void stream_avx2_nt(int kernel, double* a, double* b, double* c, size_t n, double s) {
+    STREAM_SIMD_KERNELS(__m256d, 4, _mm256_load_pd, _mm256_stream_pd, _mm256_add_pd, _mm256_mul_pd, _mm256_set1_pd)
+    _mm_sfence();
+}
+
+__attribute__((target("avx512f")))
+static void stream_avx512(int kernel, double* a, double* b, double* c, size_t n, double s) {
+    STREAM_SIMD_KERNELS(__m512d, 8, _mm512_load_pd, _mm512_store_pd, _mm512_add_pd, _mm512_mul_pd, _mm512_set1_pd)
+}
+
+__attribute__((target("avx512f")))
+static void stream_avx512_nt(int kernel, double* a, double* b, double* c, size_t n, double s) {
+    STREAM_SIMD_KERNELS(__m512d, 8, _mm512_load_pd, _mm512_stream_pd, _mm512_add_pd, _mm512_mul_pd, _mm512_set1_pd)
+    _mm_sfence();
+}
+#endif // STREAM_X86
+
+struct stream_variant {
+    const char* name;
+    stream_fn fn;
+};
+
+// every variant this cpu can run, picked at runtime.
+static inline std::vector<stream_variant> stream_variants() {
+    std::vector<stream_variant> variants;
+    variants.push_back({ "scalar", stream_scalar });
+#ifdef STREAM_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        variants.push_back({ "sse", stream_sse });
+        variants.push_back({ "sse-nt", stream_sse_nt });
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        variants.push_back({ "avx2", stream_avx2 });
+        variants.push_back({ "avx2-nt", stream_avx2_nt });
+    }
+    if (__builtin_cpu_supports("avx512f")) {
+        variants.push_back({ "avx512", stream_avx512 });
+        variants.push_back({ "avx512-nt", stream_avx512_nt });
+    }
+#endif
+    return variants;
+}
+
+// run one kernel of one variant on nthreads pinned threads, each owning a
+// contiguous chunk of the three arrays. returns the best GB/s over
+// STREAM_REPS timed runs (after one untimed run). the whole team meets at a
+// barrier before and after every run and thread 0 takes the time.
+static inline double stream_run(const stream_variant& v, int kernel, double* a, double* b, double* c,
+                                size_t n, int nthreads, const std::vector<int>& cpus) {
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, nullptr, nthreads);
+    double best = 0;
+    // chunks stay multiples of 8 doubles (one 64-byte line) for the aligned loads.
+    size_t chunk = (n / nthreads) & ~(size_t) 7;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nthreads; t++) {
+        threads.push_back(std::thread([&, t]() {
+            pin_to_cpu(cpus[t % cpus.size()]);
+            size_t off = t * chunk;
+            for (int rep = 0; rep <= STREAM_REPS; rep++) {
+                pthread_barrier_wait(&barrier);
+                double start = now_seconds();
+                v.fn(kernel, a + off, b + off, c + off, chunk, 3.0);
+                pthread_barrier_wait(&barrier);
+                double elapsed = now_seconds() - start;
+                if (t == 0 && rep > 0) {
+                    double gbs = (double) STREAM_KERNEL_BYTES[kernel] * chunk * nthreads / elapsed / 1e9;
+                    if (gbs > best) {
+                        best = gbs;
+                    }
+                }
+            }
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); t++) {
+        threads[t].join();
+    }
+    pthread_barrier_destroy(&barrier);
+    return best;
+}
+
+// split the region into three 64-byte aligned double arrays and print GB/s
+// for every kernel and variant at 1..cpus.size() threads.
+static inline int stream_bandwidth_sweep(char* p, size_t size, const std::vector<int>& cpus) {
+    if (cpus.empty()) {
+        printf("No CPUs available for bandwidth sweep.\n");
+        return EXIT_FAILURE;
+    }
+    char* base = (char*) (((uintptr_t) p + 63) & ~(uintptr_t) 63);
+    size_t usable = size - (base - p);
+    size_t n = (usable / 3 / sizeof(double)) & ~(size_t) 7;
+    double* a = (double*) base;
+    double* b = a + n;
+    double* c = b + n;
+    for (size_t i = 0; i < n; i++) {
+        a[i] = 1.0;
+        b[i] = 2.0;
+        c[i] = 0.0;
+    }
+
+    std::vector<stream_variant> variants = stream_variants();
+    printf("Stream Bandwidth, 3 x %zu MiB arrays, best of %d (GB/s)\n",
+           n * sizeof(double) / (1024 * 1024), STREAM_REPS);
+    printf("%8s %10s %10s %10s %10s %10s\n", "Threads", "Variant",
+           STREAM_KERNEL_NAMES[0], STREAM_KERNEL_NAMES[1], STREAM_KERNEL_NAMES[2], STREAM_KERNEL_NAMES[3]);
+    for (size_t nthreads = 1; nthreads <= cpus.size(); nthreads++) {
+        for (size_t v = 0; v < variants.size(); v++) {
+            printf("%8zu %10s", nthreads, variants[v].name);
+            for (int k = 0; k < STREAM_NUM_KERNELS; k++) {
+                printf(" %10.2f", stream_run(variants[v], k, a, b, c, n, (int) nthreads, cpus));
+                fflush(stdout);
+            }
+            printf("\n");
+        }
+    }
+    printf("------------------------\n");
+    return EXIT_SUCCESS;
+}
+
+#endif // STREAM_BANDWIDTH_H
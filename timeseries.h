@@ -0,0 +1,159 @@
+#ifndef TIMESERIES_H
+#define TIMESERIES_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/timerfd.h>
+#include <sys/resource.h>
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mem_access.h"
+#include "results_writer.h"
+
+// one read of everything the sampler watches.
+struct timeseries_point {
+    double time;
+    std::map<std::string, uint64_t> values;
+    long rss_kb;
+    long minflt;
+    long majflt;
+};
+
+static inline long statm_rss_kb() {
+    long size = 0, resident = 0;
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (file == nullptr) {
+        return 0;
+    }
+    if (fscanf(file, "%ld %ld", &size, &resident) != 2) {
+        resident = 0;
+    }
+    fclose(file);
+    return resident * (sysconf(_SC_PAGE_SIZE) / 1024);
+}
+
+// reads a counter set every interval from its own thread, pinned away from
+// the measured cpu and woken by a periodic timerfd, so the measured thread
+// never runs sampling code. the counters keep running throughout; each
+// point holds running totals and rates are taken between neighbours.
+class TimeSeriesSampler {
+public:
+    TimeSeriesSampler() : running_(false), counters_(nullptr) {}
+    ~TimeSeriesSampler() { stop(); }
+
+    // cpu < 0 leaves the thread unpinned. counters must outlive stop().
+    bool start(PerfCounterSet& counters, double interval_s, int cpu) {
+        int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+        if (tfd == -1) {
+            perror("Error in system call timerfd_create");
+            return false;
+        }
+        struct itimerspec its;
+        its.it_interval.tv_sec = (time_t) interval_s;
+        its.it_interval.tv_nsec = (long) ((interval_s - its.it_interval.tv_sec) * 1e9);
+        its.it_value = its.it_interval;
+        if (timerfd_settime(tfd, 0, &its, nullptr) == -1) {
+            perror("Error in system call timerfd_settime");
+            close(tfd);
+            return false;
+        }
+        points_.clear();
+        points_.push_back(take(counters));
+        counters_ = &counters;
+        running_ = true;
+        thread_ = std::thread([this, &counters, tfd, cpu] {
+            if (cpu >= 0) {
+                pin_to_cpu(cpu);
+            }
+            struct pollfd pfd = { tfd, POLLIN, 0 };
+            while (running_.load(std::memory_order_relaxed)) {
+                // wake at least every 100 ms to notice stop().
+                if (poll(&pfd, 1, 100) <= 0) {
+                    continue;
+                }
+                uint64_t expirations;
+                if (read(tfd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+                    continue;
+                }
+                points_.push_back(take(counters));
+            }
+            close(tfd);
+        });
+        return true;
+    }
+
+    // stop the thread and take a closing point.
+    void stop() {
+        if (!running_) {
+            return;
+        }
+        running_ = false;
+        thread_.join();
+        points_.push_back(take(*counters_));
+    }
+
+    const std::vector<timeseries_point>& points() const { return points_; }
+
+    // one record per interval: elapsed time, RSS, fault rates and the rate
+    // of every counter, plus L1D / DTLB miss ratios over the interval.
+    void add_records(ResultsWriter& out, const ResultRecord& context) const {
+        for (size_t i = 1; i < points_.size(); i++) {
+            const timeseries_point& a = points_[i - 1];
+            const timeseries_point& b = points_[i];
+            double dt = b.time - a.time;
+            if (dt <= 0) {
+                continue;
+            }
+            ResultRecord record;
+            record.add(context);
+            record.add("t_s", b.time - points_[0].time);
+            record.add("interval_s", dt);
+            record.add("rss_kb", b.rss_kb);
+            record.add("minflt_per_s", (b.minflt - a.minflt) / dt);
+            record.add("majflt_per_s", (b.majflt - a.majflt) / dt);
+            std::map<std::string, uint64_t> delta;
+            for (std::map<std::string, uint64_t>::const_iterator it = b.values.begin(); it != b.values.end(); ++it) {
+                uint64_t before = counter_value(a.values, it->first.c_str());
+                uint64_t d = it->second > before ? it->second - before : 0;
+                delta[it->first] = d;
+                record.add(field_key(it->first) + "_per_s", d / dt);
+            }
+            if (delta.count("L1D Read Misses") && delta.count("L1D Read Accesses")) {
+                record.add("l1d_read_miss_ratio",
+                           miss_rate(delta["L1D Read Misses"], delta["L1D Read Accesses"]));
+            }
+            if (delta.count("DTLB Load Misses") && delta.count("DTLB Load Accesses")) {
+                record.add("dtlb_load_miss_ratio",
+                           miss_rate(delta["DTLB Load Misses"], delta["DTLB Load Accesses"]));
+            }
+            out.add(record);
+        }
+    }
+
+private:
+    static timeseries_point take(PerfCounterSet& counters) {
+        timeseries_point p;
+        p.time = now_seconds();
+        p.values = counters.read();
+        p.rss_kb = statm_rss_kb();
+        struct rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        p.minflt = ru.ru_minflt;
+        p.majflt = ru.ru_majflt;
+        return p;
+    }
+
+    std::atomic<bool> running_;
+    std::thread thread_;
+    PerfCounterSet* counters_;
+    std::vector<timeseries_point> points_;
+};
+
+#endif // TIMESERIES_H
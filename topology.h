@@ -0,0 +1,387 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h> // for sched_getaffinity
+#include <unistd.h>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h> // for __get_cpuid, __get_cpuid_count
+#define TOPOLOGY_X86 1
+#endif
+
+// what the machine looks like, from /sys/devices/system/cpu with cpuid as
+// the fallback for caches where sysfs has none (some vms and containers).
+// everything that used to assume one particular box (32 KiB windows, cpus
+// 4/5/6, a fixed flush size) asks this instead.
+
+// one cache as described by /sys/devices/system/cpu/cpuN/cache/indexK.
+struct cache_level {
+    int level;
+    std::string type;       // Data, Instruction or Unified
+    size_t size;
+    size_t line;
+    std::string shared_cpus;
+};
+
+// where one logical cpu sits.
+struct cpu_place {
+    int cpu;
+    int core;               // core_id, unique within a package
+    int package;
+    int die;                // die_id, 0 where the kernel has none
+    int llc;                // lowest cpu sharing its last level cache, -1 if unknown
+    std::vector<int> siblings;  // smt threads of the same core, itself included
+};
+
+// "0-3,8" -> {0, 1, 2, 3, 8}. false on a malformed or empty list.
+static inline bool parse_cpu_list(const char* s, std::vector<int>& cpus) {
+    cpus.clear();
+    while (*s != '\0') {
+        char* end;
+        long lo = strtol(s, &end, 10);
+        if (end == s || lo < 0) {
+            return false;
+        }
+        long hi = lo;
+        if (*end == '-') {
+            s = end + 1;
+            hi = strtol(s, &end, 10);
+            if (end == s || hi < lo) {
+                return false;
+            }
+        }
+        for (long c = lo; c <= hi; c++) {
+            cpus.push_back((int) c);
+        }
+        if (*end == ',') {
+            end++;
+        } else if (*end != '\0' && *end != '\n') {
+            return false;
+        }
+        s = end;
+    }
+    return !cpus.empty();
+}
+
+static inline std::string read_sysfs_string(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == nullptr) {
+        return "";
+    }
+    char buf[256];
+    std::string s;
+    if (fgets(buf, sizeof(buf), file) != nullptr) {
+        s = buf;
+        while (!s.empty() && (s.back() == '\n' || s.back() == ' ')) {
+            s.pop_back();
+        }
+    }
+    fclose(file);
+    return s;
+}
+
+// "48K", "2048K", "32M" -> bytes.
+static inline size_t parse_cache_size(const std::string& s) {
+    char* end = nullptr;
+    size_t n = strtoull(s.c_str(), &end, 10);
+    if (end != nullptr && (*end == 'K' || *end == 'k')) {
+        n <<= 10;
+    } else if (end != nullptr && (*end == 'M' || *end == 'm')) {
+        n <<= 20;
+    }
+    return n;
+}
+
+static inline std::vector<cache_level> sysfs_cache_levels(int cpu) {
+    std::vector<cache_level> levels;
+    for (int i = 0; ; i++) {
+        std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cache/index" +
+                          std::to_string(i) + "/";
+        std::string level = read_sysfs_string(dir + "level");
+        if (level.empty()) {
+            break;
+        }
+        cache_level c;
+        c.level = atoi(level.c_str());
+        c.type = read_sysfs_string(dir + "type");
+        c.size = parse_cache_size(read_sysfs_string(dir + "size"));
+        c.line = strtoull(read_sysfs_string(dir + "coherency_line_size").c_str(), nullptr, 10);
+        c.shared_cpus = read_sysfs_string(dir + "shared_cpu_list");
+        levels.push_back(c);
+    }
+    return levels;
+}
+
+// deterministic cache parameters: leaf 4 on intel, 0x8000001d on amd. both
+// use the same register layout. sharing is not decoded, it is left empty.
+static inline std::vector<cache_level> cpuid_cache_levels() {
+    std::vector<cache_level> levels;
+#ifdef TOPOLOGY_X86
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx)) {
+        return levels;
+    }
+    unsigned int leaf = eax >= 0x8000001d ? 0x8000001d : 4;
+    __get_cpuid(0, &eax, &ebx, &ecx, &edx);
+    if (ebx == 0x756e6547) {   // "Genu"ineIntel
+        leaf = 4;
+    }
+    for (unsigned int i = 0; i < 16; i++) {
+        if (!__get_cpuid_count(leaf, i, &eax, &ebx, &ecx, &edx) || (eax & 0x1f) == 0) {
+            break;
+        }
+        static const char* const TYPES[] = { "", "Data", "Instruction", "Unified" };
+        unsigned int type = eax & 0x1f;
+        cache_level c;
+        c.level = (eax >> 5) & 0x7;
+        c.type = type < 4 ? TYPES[type] : "Unified";
+        c.line = (ebx & 0xfff) + 1;
+        size_t partitions = ((ebx >> 12) & 0x3ff) + 1;
+        size_t ways = ((ebx >> 22) & 0x3ff) + 1;
+        c.size = ways * partitions * c.line * ((size_t) ecx + 1);
+        levels.push_back(c);
+    }
+#endif
+    return levels;
+}
+
+// clflush line size from cpuid leaf 1, 0 where there is no cpuid.
+static inline size_t cpuid_line_size() {
+#ifdef TOPOLOGY_X86
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return ((ebx >> 8) & 0xff) * 8;
+    }
+#endif
+    return 0;
+}
+
+// the caches cpu sees, innermost first. empty if neither source has any.
+static inline std::vector<cache_level> read_cache_levels(int cpu) {
+    std::vector<cache_level> levels = sysfs_cache_levels(cpu);
+    return levels.empty() ? cpuid_cache_levels() : levels;
+}
+
+static inline cpu_place read_cpu_place(int cpu) {
+    std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+    cpu_place place;
+    place.cpu = cpu;
+    std::string core = read_sysfs_string(dir + "core_id");
+    std::string package = read_sysfs_string(dir + "physical_package_id");
+    place.core = core.empty() ? cpu : atoi(core.c_str());
+    place.package = package.empty() ? 0 : atoi(package.c_str());
+    std::string die = read_sysfs_string(dir + "die_id");
+    place.die = die.empty() ? 0 : atoi(die.c_str());
+    if (!parse_cpu_list(read_sysfs_string(dir + "thread_siblings_list").c_str(), place.siblings)) {
+        place.siblings.assign(1, cpu);
+    }
+    // the highest indexK is the last level; its sharing list names the
+    // cpus behind the same llc (a ccx on amd, the whole die on intel).
+    place.llc = -1;
+    std::vector<cache_level> levels = sysfs_cache_levels(cpu);
+    if (!levels.empty()) {
+        std::vector<int> shared;
+        if (parse_cpu_list(levels.back().shared_cpus.c_str(), shared)) {
+            place.llc = shared[0];
+        }
+    }
+    return place;
+}
+
+class Topology {
+public:
+    // the layout covers every cpu this process may run on, so build it
+    // before pinning. caches are read for the first of them until
+    // select_cpu() names the measured one (they differ on hybrid parts).
+    Topology() : line_(0) {
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+            for (int c = 0; c < CPU_SETSIZE; c++) {
+                if (CPU_ISSET(c, &mask)) {
+                    cpus_.push_back(read_cpu_place(c));
+                }
+            }
+        }
+        select_cpu(cpus_.empty() ? 0 : cpus_[0].cpu);
+    }
+
+    void select_cpu(int cpu) {
+        caches_ = read_cache_levels(cpu);
+        line_ = 0;
+        for (size_t i = 0; i < caches_.size() && line_ == 0; i++) {
+            line_ = caches_[i].line;
+        }
+        if (line_ == 0) {
+            line_ = cpuid_line_size();
+        }
+    }
+
+    const std::vector<cache_level>& caches() const { return caches_; }
+    const std::vector<cpu_place>& cpus() const { return cpus_; }
+
+    // 0 if unknown.
+    size_t line_size() const { return line_; }
+
+    // data (or unified) capacity at level, the last level for level <= 0.
+    // 0 if unknown.
+    size_t data_cache_size(int level) const {
+        size_t size = 0;
+        int found = 0;
+        for (size_t i = 0; i < caches_.size(); i++) {
+            if (caches_[i].type == "Instruction") {
+                continue;
+            }
+            if (caches_[i].level == level || (level <= 0 && caches_[i].level >= found)) {
+                found = caches_[i].level;
+                size = caches_[i].size;
+            }
+        }
+        return size;
+    }
+
+    size_t llc_size() const { return data_cache_size(0); }
+
+    const cpu_place* place(int cpu) const {
+        for (size_t i = 0; i < cpus_.size(); i++) {
+            if (cpus_[i].cpu == cpu) {
+                return &cpus_[i];
+            }
+        }
+        return nullptr;
+    }
+
+    // from thread_siblings_list: core_id is only unique within a die, so
+    // matching package and core can pair threads of different cores.
+    bool smt_siblings(int a, int b) const {
+        const cpu_place* pa = place(a);
+        if (pa == nullptr || place(b) == nullptr) {
+            return false;
+        }
+        for (size_t i = 0; i < pa->siblings.size(); i++) {
+            if (pa->siblings[i] == b) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // how far apart two cpus sit, nearest first.
+    const char* relation(int a, int b) const {
+        const cpu_place* pa = place(a);
+        const cpu_place* pb = place(b);
+        if (pa == nullptr || pb == nullptr) {
+            return "unknown";
+        }
+        if (a == b) {
+            return "same cpu";
+        }
+        if (smt_siblings(a, b)) {
+            return "smt sibling";
+        }
+        if (pa->package != pb->package) {
+            return "cross package";
+        }
+        if (pa->llc >= 0 && pa->llc == pb->llc) {
+            return "same llc";
+        }
+        if (pa->die == pb->die) {
+            return "same die";
+        }
+        return "same package";
+    }
+
+    // the cpu to measure on: the first thread of the second core of the
+    // first package, keeping off core 0 where most housekeeping and
+    // interrupts land. falls back to whatever is there.
+    int measure_cpu() const {
+        std::vector<int> primaries = spread();
+        if (primaries.empty()) {
+            return 0;
+        }
+        for (size_t i = 0; i < primaries.size(); i++) {
+            const cpu_place* p = place(primaries[i]);
+            if (p->package == place(primaries[0])->package && !smt_siblings(primaries[i], primaries[0])) {
+                return primaries[i];
+            }
+        }
+        return primaries[0];
+    }
+
+    // a cpu for a helper (sampler, co-runner) next to measured: another core
+    // of the same package if there is one, then another package, then an
+    // smt sibling. -1 if measured is the only cpu.
+    int helper_cpu(int measured) const {
+        const cpu_place* m = place(measured);
+        int other_package = -1, sibling = -1;
+        std::vector<int> order = spread();
+        for (size_t i = 0; i < order.size(); i++) {
+            int c = order[i];
+            if (c == measured) {
+                continue;
+            }
+            if (smt_siblings(c, measured)) {
+                sibling = sibling < 0 ? c : sibling;
+            } else if (m != nullptr && place(c)->package != m->package) {
+                other_package = other_package < 0 ? c : other_package;
+            } else {
+                return c;
+            }
+        }
+        return other_package >= 0 ? other_package : sibling;
+    }
+
+    // every cpu, one thread per physical core first and smt siblings after,
+    // so a thread sweep fills cores before it doubles up on them.
+    std::vector<int> spread() const {
+        std::vector<int> first, rest;
+        for (size_t i = 0; i < cpus_.size(); i++) {
+            (is_primary(cpus_[i]) ? first : rest).push_back(cpus_[i].cpu);
+        }
+        first.insert(first.end(), rest.begin(), rest.end());
+        return first;
+    }
+
+    void print() const {
+        size_t cores = 0;
+        std::vector<int> packages;
+        for (size_t i = 0; i < cpus_.size(); i++) {
+            cores += is_primary(cpus_[i]) ? 1 : 0;
+            bool seen = false;
+            for (size_t p = 0; p < packages.size(); p++) {
+                seen |= packages[p] == cpus_[i].package;
+            }
+            if (!seen) {
+                packages.push_back(cpus_[i].package);
+            }
+        }
+        printf("Topology: %zu cpus, %zu cores, %zu packages, %zu B lines\n", cpus_.size(), cores,
+               packages.size(), line_);
+        for (size_t i = 0; i < caches_.size(); i++) {
+            printf("L%d %-11s %8zu KiB, %zu B lines, shared with cpus %s\n", caches_[i].level,
+                   caches_[i].type.c_str(), caches_[i].size >> 10, caches_[i].line,
+                   caches_[i].shared_cpus.empty() ? "?" : caches_[i].shared_cpus.c_str());
+        }
+    }
+
+private:
+    // the lowest numbered of its core's threads that we may run on.
+    bool is_primary(const cpu_place& c) const {
+        for (size_t s = 0; s < c.siblings.size(); s++) {
+            if (c.siblings[s] < c.cpu && place(c.siblings[s]) != nullptr) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::vector<cache_level> caches_;
+    std::vector<cpu_place> cpus_;
+    size_t line_;
+};
+
+#endif // TOPOLOGY_H
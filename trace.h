@@ -0,0 +1,242 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h> // for open
+#include <sys/mman.h> // for mmap
+#include <sys/stat.h> // for fstat
+#include <unistd.h>
+#include <cstdint> // for uint64_t
+#include <vector>
+
+#include "mem_access.h"
+
+// address trace file:
+//   trace_header, then one varint per record.
+// a record is a cache line index relative to the start of the region. each
+// is stored as the zigzag encoded delta from the previous record, shifted
+// left one bit with the store flag in bit 0, then LEB128 encoded. random
+// window starts over 1GB take ~4 bytes, sequential ones 2.
+//
+// window traces (captured from do_mem_access) keep one record per window and
+// the header carries the window/locality/write knobs, so replay walks the
+// same lines. line traces (imported from a service) keep one record per
+// access with window_lines = locality = 1 and use the per-record store flag.
+#define TRACE_MAGIC "MEMTRC01"
+#define TRACE_PER_ACCESS_WRITES 1
+
+struct trace_header {
+    char magic[8];
+    uint64_t records;
+    uint64_t region_bytes;   // size of the region the trace was taken on
+    uint32_t window_lines;
+    uint32_t locality;
+    uint32_t line_stride;
+    uint32_t flags;
+    double write_fraction;
+};
+
+static inline uint64_t zigzag_encode(int64_t v) {
+    return ((uint64_t) v << 1) ^ (uint64_t) (v >> 63);
+}
+
+static inline int64_t zigzag_decode(uint64_t v) {
+    return (int64_t) (v >> 1) ^ -(int64_t) (v & 1);
+}
+
+// buffered writer; all writes go through stdio, outside any measured window.
+class TraceWriter {
+public:
+    TraceWriter() : file_(nullptr), last_(0) { memset(&header_, 0, sizeof(header_)); }
+    ~TraceWriter() { close(); }
+
+    bool open(const char* path, const access_params& params, uint64_t region_bytes, uint32_t flags) {
+        file_ = fopen(path, "wb");
+        if (file_ == nullptr) {
+            perror("Error in system call fopen");
+            return false;
+        }
+        memcpy(header_.magic, TRACE_MAGIC, sizeof(header_.magic));
+        header_.records = 0;
+        header_.region_bytes = region_bytes;
+        header_.window_lines = params.window_lines;
+        header_.locality = params.locality;
+        header_.line_stride = params.line_stride;
+        header_.flags = flags;
+        header_.write_fraction = params.write_fraction;
+        // placeholder, rewritten with the record count on close.
+        fwrite(&header_, sizeof(header_), 1, file_);
+        last_ = 0;
+        return true;
+    }
+
+    void append(long line, bool write) {
+        uint64_t v = (zigzag_encode(line - last_) << 1) | (write ? 1 : 0);
+        last_ = line;
+        uint8_t buf[10];
+        int n = 0;
+        do {
+            uint8_t byte = v & 0x7f;
+            v >>= 7;
+            buf[n++] = byte | (v ? 0x80 : 0);
+        } while (v);
+        fwrite(buf, 1, n, file_);
+        header_.records++;
+    }
+
+    bool close() {
+        if (file_ == nullptr) {
+            return true;
+        }
+        fseek(file_, 0, SEEK_SET);
+        fwrite(&header_, sizeof(header_), 1, file_);
+        bool ok = fclose(file_) == 0;
+        file_ = nullptr;
+        return ok;
+    }
+
+private:
+    FILE* file_;
+    trace_header header_;
+    long last_;
+};
+
+// write the window starts of one precomputed do_mem_access walk.
+static inline bool record_trace(const char* path, const std::vector<long>& bases,
+                                const access_params& params, uint64_t region_bytes) {
+    TraceWriter writer;
+    if (!writer.open(path, params, region_bytes, 0)) {
+        return false;
+    }
+    for (size_t i = 0; i < bases.size(); i++) {
+        writer.append(bases[i], false);
+    }
+    printf("Recorded %zu windows to %s.\n", bases.size(), path);
+    return writer.close();
+}
+
+// a trace mapped read-only. the pages are populated up front and marked
+// sequential so replay never faults on the trace inside a measured window.
+struct MappedTrace {
+    const trace_header* header;
+    const uint8_t* data;
+    const uint8_t* end;
+    size_t length;
+
+    MappedTrace() : header(nullptr), data(nullptr), end(nullptr), length(0) {}
+    ~MappedTrace() { unmap(); }
+
+    MappedTrace(const MappedTrace&) = delete;
+    MappedTrace& operator=(const MappedTrace&) = delete;
+
+    bool map(const char* path) {
+        int fd = ::open(path, O_RDONLY);
+        if (fd == -1) {
+            perror("Oh no. Trace Open Failed.");
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == -1 || (size_t) st.st_size < sizeof(trace_header)) {
+            printf("Trace file %s is too short.\n", path);
+            ::close(fd);
+            return false;
+        }
+        length = st.st_size;
+        void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            perror("Oh no. Trace Mapping Failed.");
+            return false;
+        }
+        madvise(p, length, MADV_SEQUENTIAL);
+        header = (const trace_header*) p;
+        if (memcmp(header->magic, TRACE_MAGIC, sizeof(header->magic)) != 0) {
+            printf("%s is not a trace file.\n", path);
+            unmap();
+            return false;
+        }
+        data = (const uint8_t*) p + sizeof(trace_header);
+        end = (const uint8_t*) p + length;
+        // every record is at least one byte; a window needs a line.
+        if (header->records == 0 || header->records > (uint64_t) (end - data) || header->window_lines == 0 ||
+            header->locality == 0 || header->line_stride == 0) {
+            printf("Trace file %s has a corrupt header.\n", path);
+            unmap();
+            return false;
+        }
+        return true;
+    }
+
+    void unmap() {
+        if (header != nullptr) {
+            munmap((void*) header, length);
+        }
+        header = nullptr;
+    }
+
+    // the walk knobs the trace was captured with.
+    access_params params() const {
+        access_params params = DEFAULT_ACCESS_PARAMS;
+        params.iterations = header->records;
+        params.window_lines = header->window_lines;
+        params.locality = header->locality;
+        params.line_stride = header->line_stride;
+        params.write_fraction = header->write_fraction;
+        return params;
+    }
+};
+
+// drive the region at p with the exact sequence in the trace. decoding
+// reads the mapping in place (no copy) and prefetches a few lines of trace
+// ahead. records beyond the end of a smaller region wrap around it.
+static inline void replay_trace(char* p, size_t size, const MappedTrace& trace) {
+    access_params params = trace.params();
+    long max_base = (long) (size / CACHE_LINE_SIZE) - (long) params.window_lines * params.line_stride;
+    if (max_base < 0) {
+        printf("Region too small for the trace window.\n");
+        return;
+    }
+    bool per_access = trace.header->flags & TRACE_PER_ACCESS_WRITES;
+    const uint8_t* in = trace.data;
+    long line = 0;
+    while (in < trace.end) {
+        __builtin_prefetch(in + 4 * CACHE_LINE_SIZE);
+        uint64_t v = 0;
+        int shift = 0;
+        uint8_t byte;
+        do {
+            if (in == trace.end || shift > 63) {
+                printf("Trace is truncated or corrupt, replay stopped.\n");
+                return;
+            }
+            byte = *in++;
+            v |= (uint64_t) (byte & 0x7f) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        line += zigzag_decode(v >> 1);
+        unsigned long base = (unsigned long) line;
+        if (base > (unsigned long) max_base) {
+            base %= (unsigned long) max_base + 1;
+        }
+        if (per_access) {
+            volatile char* a = p + base * CACHE_LINE_SIZE;
+            if (v & 1) {
+                *a = 1;
+            } else {
+                char c = *a;
+                (void) c;
+            }
+        } else {
+            touch_window(p, (long) base, params);
+        }
+    }
+}
+
+// cache lines one replay touches.
+static inline double trace_lines(const MappedTrace& trace) {
+    return mem_access_lines(trace.params());
+}
+
+#endif // TRACE_H
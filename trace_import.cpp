@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <cstdint> // for uint64_t
+#include <vector>
+
+#include "trace.h"
+
+// convert a text address trace from a service into a line trace that the
+// mem access drivers can replay. one access per input line:
+//   <address> [r|w]
+// addresses are hex, with or without a 0x prefix (pin and valgrind write
+// them bare); the access is a load unless the second field starts with
+// w/W/s/S. blank lines and # comments are skipped, and so is any line whose
+// address does not parse, with a count at the end. addresses are cut down to cache line
+// indices and rebased to the lowest line, so accesses to one real line
+// always share an index.
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        printf("Usage: %s <text trace in> <binary trace out>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE* file = fopen(argv[1], "r");
+    if (file == nullptr) {
+        perror("Error in system call fopen");
+        return EXIT_FAILURE;
+    }
+
+    std::vector<uint64_t> addrs;
+    std::vector<bool> writes;
+    uint64_t lowest = UINT64_MAX;
+    size_t rejected = 0;
+    char buffer[256];
+    while (fgets(buffer, sizeof(buffer), file) != nullptr) {
+        char kind[16] = "r";
+        char* start = buffer + strspn(buffer, " \t");
+        if (*start == '\0' || *start == '\n' || *start == '\r' || *start == '#') {
+            continue;
+        }
+        // base 16 explicitly: base 0 reads a leading 0 as octal and stops
+        // bare hex at its first a-f digit.
+        char* endp;
+        uint64_t addr = strtoull(start, &endp, 16);
+        if (!isxdigit((unsigned char) *start) || endp == start ||
+            (*endp != '\0' && !isspace((unsigned char) *endp))) {
+            rejected++;
+            continue;
+        }
+        sscanf(endp, "%15s", kind);
+        addrs.push_back(addr);
+        writes.push_back(strchr("wWsS", kind[0]) != nullptr);
+        if (addr < lowest) {
+            lowest = addr;
+        }
+    }
+    fclose(file);
+    if (rejected > 0) {
+        printf("Skipped %zu lines without a hex address.\n", rejected);
+    }
+    if (addrs.empty()) {
+        printf("No accesses in %s.\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    uint64_t lowest_line = lowest / CACHE_LINE_SIZE;
+    uint64_t highest_line = 0;
+    for (size_t i = 0; i < addrs.size(); i++) {
+        if (addrs[i] / CACHE_LINE_SIZE - lowest_line > highest_line) {
+            highest_line = addrs[i] / CACHE_LINE_SIZE - lowest_line;
+        }
+    }
+    uint64_t region_bytes = (highest_line + 1) * CACHE_LINE_SIZE;
+
+    access_params params = DEFAULT_ACCESS_PARAMS;
+    params.window_lines = 1;
+    params.locality = 1;
+    params.line_stride = 1;
+    params.write_fraction = 0;
+    TraceWriter writer;
+    if (!writer.open(argv[2], params, region_bytes, TRACE_PER_ACCESS_WRITES)) {
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < addrs.size(); i++) {
+        writer.append((long) (addrs[i] / CACHE_LINE_SIZE - lowest_line), writes[i]);
+    }
+    if (!writer.close()) {
+        perror("Error writing trace");
+        return EXIT_FAILURE;
+    }
+    printf("Imported %zu accesses spanning %.1f MiB.\n", addrs.size(), region_bytes / 1048576.0);
+    return EXIT_SUCCESS;
+}
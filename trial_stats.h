@@ -0,0 +1,147 @@
+#ifndef TRIAL_STATS_H
+#define TRIAL_STATS_H
+
+#include <stdio.h>
+#include <math.h>
+#include <algorithm> // for std::sort
+#include <map>
+#include <string>
+#include <vector>
+
+#include "rng.h"
+
+// bootstrap resamples per confidence interval.
+#define BOOTSTRAP_RESAMPLES 2000
+
+// summary of one metric over the measured trials.
+struct sample_summary {
+    size_t n;
+    double mean;
+    double stddev;      // sample standard deviation (n - 1)
+    double median;
+    double p5;
+    double p95;
+    double min;
+    double max;
+    double ci_lo;       // bootstrap confidence interval of the median
+    double ci_hi;
+    size_t outliers;    // outside the tukey fences (1.5 IQR past the quartiles)
+};
+
+// linear interpolation between closest ranks; sorted must be sorted.
+static inline double percentile(const std::vector<double>& sorted, double q) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    double pos = q * (sorted.size() - 1);
+    size_t lo = (size_t) pos;
+    size_t hi = lo + 1 < sorted.size() ? lo + 1 : lo;
+    double frac = pos - lo;
+    return sorted[lo] * (1 - frac) + sorted[hi] * frac;
+}
+
+// mean, spread, percentiles, tukey outliers and a percentile bootstrap CI of
+// the median at the given confidence. the resampling seed is fixed so the
+// same samples always give the same interval.
+static inline sample_summary summarize(const std::vector<double>& samples, double confidence = 0.95) {
+    sample_summary s = sample_summary();
+    s.n = samples.size();
+    if (s.n == 0) {
+        return s;
+    }
+    std::vector<double> sorted(samples);
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0;
+    for (size_t i = 0; i < s.n; i++) {
+        sum += sorted[i];
+    }
+    s.mean = sum / s.n;
+    double sq = 0;
+    for (size_t i = 0; i < s.n; i++) {
+        sq += (sorted[i] - s.mean) * (sorted[i] - s.mean);
+    }
+    s.stddev = s.n > 1 ? sqrt(sq / (s.n - 1)) : 0;
+    s.median = percentile(sorted, 0.5);
+    s.p5 = percentile(sorted, 0.05);
+    s.p95 = percentile(sorted, 0.95);
+    s.min = sorted.front();
+    s.max = sorted.back();
+
+    double q1 = percentile(sorted, 0.25);
+    double q3 = percentile(sorted, 0.75);
+    double fence = 1.5 * (q3 - q1);
+    for (size_t i = 0; i < s.n; i++) {
+        if (sorted[i] < q1 - fence || sorted[i] > q3 + fence) {
+            s.outliers++;
+        }
+    }
+
+    Xoshiro256ss rng(0x5eed);
+    std::vector<double> medians(BOOTSTRAP_RESAMPLES);
+    std::vector<double> resample(s.n);
+    for (int b = 0; b < BOOTSTRAP_RESAMPLES; b++) {
+        for (size_t i = 0; i < s.n; i++) {
+            resample[i] = sorted[rng.below(s.n)];
+        }
+        std::sort(resample.begin(), resample.end());
+        medians[b] = percentile(resample, 0.5);
+    }
+    std::sort(medians.begin(), medians.end());
+    double tail = (1 - confidence) / 2;
+    s.ci_lo = percentile(medians, tail);
+    s.ci_hi = percentile(medians, 1 - tail);
+    return s;
+}
+
+// per-trial samples of every metric, kept in the order metrics first appear.
+class TrialStats {
+public:
+    void add(const std::string& name, double value) {
+        if (samples_.find(name) == samples_.end()) {
+            order_.push_back(name);
+        }
+        samples_[name].push_back(value);
+    }
+
+    void add(const std::map<std::string, uint64_t>& values) {
+        for (std::map<std::string, uint64_t>::const_iterator it = values.begin(); it != values.end(); ++it) {
+            add(it->first, (double) it->second);
+        }
+    }
+
+    sample_summary summary(const std::string& name, double confidence = 0.95) const {
+        std::map<std::string, std::vector<double> >::const_iterator it = samples_.find(name);
+        if (it == samples_.end()) {
+            return sample_summary();
+        }
+        return summarize(it->second, confidence);
+    }
+
+    // CI width of the median relative to the median. infinite until there
+    // are enough samples to say anything.
+    double relative_ci_width(const std::string& name, double confidence = 0.95) const {
+        sample_summary s = summary(name, confidence);
+        if (s.n < 3 || s.median == 0) {
+            return INFINITY;
+        }
+        return (s.ci_hi - s.ci_lo) / fabs(s.median);
+    }
+
+    const std::vector<std::string>& names() const { return order_; }
+
+    void print(double confidence = 0.95) const {
+        printf("%-24s %5s %14s %14s %14s %14s %14s %29s %4s\n", "Metric", "N", "Median", "Mean", "Stddev",
+               "P5", "P95", "Median CI", "Out");
+        for (size_t m = 0; m < order_.size(); m++) {
+            sample_summary s = summary(order_[m], confidence);
+            printf("%-24s %5zu %14.6g %14.6g %14.6g %14.6g %14.6g  [%12.6g, %12.6g] %4zu\n",
+                   order_[m].c_str(), s.n, s.median, s.mean, s.stddev, s.p5, s.p95, s.ci_lo, s.ci_hi, s.outliers);
+        }
+    }
+
+private:
+    std::vector<std::string> order_;
+    std::map<std::string, std::vector<double> > samples_;
+};
+
+#endif // TRIAL_STATS_H